@@ -0,0 +1,59 @@
+// Prints CAN traffic mirrored by the server's shared-memory tap.
+//
+// Enable the tap from Lua with enableShmTap("can_tap"), then run:
+//   ./ShmTapReader can_tap
+
+#include <shm/ShmRingReader.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+int main(int argc, char *argv[]) {
+  std::string name = argc > 1 ? argv[1] : "can_tap";
+
+  ShmRingReader reader;
+  while (!reader.open(name)) {
+    std::printf("Waiting for shared memory tap %s...\n", name.c_str());
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+  std::printf("Reading shared memory tap %s\n", name.c_str());
+
+  uint64_t lostReported = 0;
+  while (true) {
+    const ShmRing::Slot *slot = reader.peek();
+    if (slot == nullptr) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+
+    // Format from the shared slot, then check it was not overwritten
+    char line[256];
+    int length = std::snprintf(
+        line, sizeof(line), "%llu %s %-15.15s %X%s%s [%u]",
+        static_cast<unsigned long long>(slot->timestamp),
+        slot->direction == static_cast<uint8_t>(ShmRing::Direction::Inbound)
+            ? "RX"
+            : "TX",
+        slot->sessionId, slot->canId,
+        (slot->flags & ShmRing::FlagExtended) ? " EXT" : "",
+        (slot->flags & ShmRing::FlagRtr) ? " RTR" : "", slot->length);
+    for (uint8_t i = 0; i < slot->length && length > 0 &&
+                        length < static_cast<int>(sizeof(line)) - 3;
+         ++i) {
+      length += std::snprintf(line + length, sizeof(line) - length, " %02X",
+                              slot->data[i]);
+    }
+
+    if (reader.release()) {
+      std::printf("%s\n", line);
+    }
+
+    if (reader.lostRecords() != lostReported) {
+      lostReported = reader.lostRecords();
+      std::printf("-- %llu records lost so far\n",
+                  static_cast<unsigned long long>(lostReported));
+    }
+  }
+}
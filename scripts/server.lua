@@ -27,7 +27,7 @@ function setupCallbacks()
         log("Client disconnected: " .. clientId)
     end
 
-    function onMessageReceived(clientId, canId, data, extended, rtr)
+    function onMessageReceived(clientId, canId, data, extended, rtr, timestamp)
         log("Received message from " .. clientId .. " - CAN ID: 0x" .. string.format("%X", canId))
 
         -- Print the data bytes
@@ -41,8 +41,9 @@ function setupCallbacks()
         dataStr = dataStr .. "]"
         log(dataStr)
 
-        -- Echo the message back to sender
-        local echoMsg = createCANMessage(canId + 1, data, extended, rtr)
+        -- Echo the message back to sender, keeping the receive time so the
+        -- client can measure the round trip when wire timestamps are on
+        local echoMsg = createCANMessage(canId + 1, data, extended, rtr, timestamp)
         sendCANMessage(clientId, echoMsg)
 
         -- If it's a broadcast request (CAN ID 0x200), send to all clients
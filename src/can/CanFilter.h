@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// Acceptance filter in the usual CAN controller style: a frame matches when
+// all bits selected by mask are equal in the frame ID and the filter ID.
+struct CanFilter {
+  static constexpr uint32_t ExactMask = 0x1FFFFFFF;
+
+  uint32_t id = 0;
+  uint32_t mask = ExactMask;
+
+  bool matches(uint32_t canId) const { return (canId & mask) == (id & mask); }
+
+  // Filters covering every bit of a 29-bit ID select exactly one ID
+  bool isExact() const { return (mask & ExactMask) == ExactMask; }
+};
@@ -1,19 +1,23 @@
 #include "CanMessage.h"
 
+#include <chrono>
 #include <iomanip>
 #include <sstream>
 
-CanMessage::CanMessage() : m_id(0), m_data(), m_extended(false), m_rtr(false) {}
+CanMessage::CanMessage()
+    : m_id(0), m_data(), m_extended(false), m_rtr(false), m_control(false),
+      m_timestamp(0) {}
 
 CanMessage::CanMessage(uint32_t id, const std::vector<uint8_t> &data,
                        bool extended, bool rtr)
-    : m_id(id), m_data(data), m_extended(extended), m_rtr(rtr) {}
+    : m_id(id), m_data(data), m_extended(extended), m_rtr(rtr),
+      m_control(false), m_timestamp(0) {}
 
 uint32_t CanMessage::getID() const { return m_id; }
 
 void CanMessage::setID(uint32_t id) { m_id = id; }
 
-std::vector<uint8_t> CanMessage::getData() const { return m_data; }
+const std::vector<uint8_t> &CanMessage::getData() const { return m_data; }
 
 void CanMessage::setData(const std::vector<uint8_t> &data) { m_data = data; }
 
@@ -25,13 +29,28 @@ bool CanMessage::isRTR() const { return m_rtr; }
 
 void CanMessage::setRTR(bool rtr) { m_rtr = rtr; }
 
-std::vector<uint8_t> CanMessage::serialize() const {
+uint64_t CanMessage::getTimestamp() const { return m_timestamp; }
+
+void CanMessage::setTimestamp(uint64_t timestamp) { m_timestamp = timestamp; }
+
+bool CanMessage::isControl() const { return m_control; }
+
+void CanMessage::setControl(bool control) { m_control = control; }
+
+std::vector<uint8_t> CanMessage::serialize(bool withTimestamp) const {
   std::vector<uint8_t> result;
+  serializeTo(result, withTimestamp);
+  return result;
+}
 
+void CanMessage::serializeTo(std::vector<uint8_t> &result,
+                             bool withTimestamp) const {
   // Format:
   // - 4 bytes for ID
-  // - 1 byte for flags (bit 0: extended, bit 1: rtr)
+  // - 1 byte for flags (bit 0: extended, bit 1: rtr, bit 2: control,
+  //   bit 3: timestamp present)
   // - 1 byte for data length
+  // - 8 bytes for timestamp (only if flagged)
   // - N bytes for data
 
   // ID (4 bytes)
@@ -46,19 +65,32 @@ std::vector<uint8_t> CanMessage::serialize() const {
     flags |= 0x01;
   if (m_rtr)
     flags |= 0x02;
+  if (m_control)
+    flags |= 0x04;
+  if (withTimestamp)
+    flags |= 0x08;
   result.push_back(flags);
 
   // Data length
   result.push_back(static_cast<uint8_t>(m_data.size()));
 
+  // Timestamp (8 bytes)
+  if (withTimestamp) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      result.push_back(static_cast<uint8_t>((m_timestamp >> shift) & 0xFF));
+    }
+  }
+
   // Data
   result.insert(result.end(), m_data.begin(), m_data.end());
-
-  return result;
 }
 
 CanMessage CanMessage::deserialize(const std::vector<uint8_t> &bytes) {
-  if (bytes.size() < 6) {
+  return deserialize(bytes.data(), bytes.size());
+}
+
+CanMessage CanMessage::deserialize(const uint8_t *bytes, std::size_t size) {
+  if (size < 6) {
     // Not enough data for a valid message
     return CanMessage();
   }
@@ -72,19 +104,34 @@ CanMessage CanMessage::deserialize(const std::vector<uint8_t> &bytes) {
   // Extract flags
   bool extended = (bytes[4] & 0x01) != 0;
   bool rtr = (bytes[4] & 0x02) != 0;
+  bool control = (bytes[4] & 0x04) != 0;
+  bool hasTimestamp = (bytes[4] & 0x08) != 0;
 
   // Extract data length
   uint8_t dataLength = bytes[5];
+  std::size_t dataOffset = hasTimestamp ? 14 : 6;
 
   // Ensure we have enough bytes for the data
-  if (bytes.size() < 6 + dataLength) {
+  if (size < dataOffset + dataLength) {
     return CanMessage();
   }
 
+  // Extract timestamp
+  uint64_t timestamp = 0;
+  if (hasTimestamp) {
+    for (std::size_t i = 6; i < 14; ++i) {
+      timestamp = timestamp << 8 | bytes[i];
+    }
+  }
+
   // Extract data
-  std::vector<uint8_t> data(bytes.begin() + 6, bytes.begin() + 6 + dataLength);
+  std::vector<uint8_t> data(bytes + dataOffset,
+                            bytes + dataOffset + dataLength);
 
-  return CanMessage(id, data, extended, rtr);
+  CanMessage message(id, data, extended, rtr);
+  message.setControl(control);
+  message.setTimestamp(timestamp);
+  return message;
 }
 
 std::string CanMessage::toString() const {
@@ -99,4 +146,11 @@ std::string CanMessage::toString() const {
   }
 
   return stringSteam.str();
+}
+
+uint64_t CanMessage::currentTimestamp() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
 }
\ No newline at end of file
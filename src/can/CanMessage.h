@@ -1,11 +1,15 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
 
 class CanMessage {
 public:
+  // Largest payload of a CAN FD frame
+  static constexpr std::size_t MaxDataLength = 64;
+
   CanMessage();
   CanMessage(uint32_t id, const std::vector<uint8_t> &data,
              bool extended = false, bool rtr = false);
@@ -13,7 +17,7 @@ public:
   uint32_t getID() const;
   void setID(uint32_t id);
 
-  std::vector<uint8_t> getData() const;
+  const std::vector<uint8_t> &getData() const;
   void setData(const std::vector<uint8_t> &data);
 
   bool isExtended() const;
@@ -22,18 +26,36 @@ public:
   bool isRTR() const;
   void setRTR(bool rtr);
 
+  // Monotonic receive time in nanoseconds, 0 if unknown
+  uint64_t getTimestamp() const;
+  void setTimestamp(uint64_t timestamp);
+
+  // Control frames carry server commands (e.g. subscriptions), not CAN data
+  bool isControl() const;
+  void setControl(bool control);
+
   // Convert to byte array for transmission
-  std::vector<uint8_t> serialize() const;
+  std::vector<uint8_t> serialize(bool withTimestamp = false) const;
+
+  // Append the serialized form to an existing buffer
+  void serializeTo(std::vector<uint8_t> &result,
+                   bool withTimestamp = false) const;
 
   // Create from byte array
   static CanMessage deserialize(const std::vector<uint8_t> &bytes);
+  static CanMessage deserialize(const uint8_t *bytes, std::size_t size);
 
   // String representation for logging
   std::string toString() const;
 
+  // Current time on the clock used for timestamps
+  static uint64_t currentTimestamp();
+
 private:
   uint32_t m_id;
   std::vector<uint8_t> m_data;
   bool m_extended;
   bool m_rtr;
+  bool m_control;
+  uint64_t m_timestamp;
 };
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "DbcDatabase.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cmath>
+#include <fstream>
+#include <regex>
+#include <stdexcept>
+
+namespace {
+
+// DBC files flag extended IDs with the top bit
+constexpr uint32_t DbcExtendedFlag = 0x80000000;
+
+uint64_t loadLittleEndian(const std::vector<uint8_t> &data) {
+  uint64_t word = 0;
+  for (std::size_t i = 0; i < data.size() && i < 8; ++i) {
+    word |= static_cast<uint64_t>(data[i]) << (8 * i);
+  }
+  return word;
+}
+
+uint64_t loadBigEndian(const std::vector<uint8_t> &data) {
+  uint64_t word = 0;
+  for (std::size_t i = 0; i < data.size() && i < 8; ++i) {
+    word |= static_cast<uint64_t>(data[i]) << (56 - 8 * i);
+  }
+  return word;
+}
+
+void storeLittleEndian(uint64_t word, std::vector<uint8_t> &data) {
+  for (std::size_t i = 0; i < data.size() && i < 8; ++i) {
+    data[i] = static_cast<uint8_t>((word >> (8 * i)) & 0xFF);
+  }
+}
+
+void storeBigEndian(uint64_t word, std::vector<uint8_t> &data) {
+  for (std::size_t i = 0; i < data.size() && i < 8; ++i) {
+    data[i] = static_cast<uint8_t>((word >> (56 - 8 * i)) & 0xFF);
+  }
+}
+
+} // namespace
+
+const DbcSignal *DbcMessage::findSignal(const std::string &name) const {
+  auto it = signalIndex.find(name);
+  if (it == signalIndex.end()) {
+    return nullptr;
+  }
+  return &signalList[it->second];
+}
+
+bool DbcMessage::isActive(const DbcSignal &signal,
+                          const std::vector<uint8_t> &data) const {
+  if (signal.multiplexValue < 0 || multiplexor < 0) {
+    return true;
+  }
+
+  return DbcDatabase::extractRaw(signalList[multiplexor], data) ==
+         signal.multiplexValue;
+}
+
+bool DbcDatabase::load(const std::string &filename) {
+  std::ifstream file(filename);
+  if (!file) {
+    spdlog::error("Cannot open DBC file: {}", filename);
+    return false;
+  }
+
+  // BO_ <id> <name>: <length> <transmitter>
+  static const std::regex messagePattern(
+      R"(^\s*BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+))");
+  // SG_ <name> [M|m<n>] : <start>|<length>@<order><sign> (<scale>,<offset>)
+  //     [<min>|<max>] "<unit>" <receivers>
+  static const std::regex signalPattern(
+      R"(^\s*SG_\s+(\w+)\s*(M|m\d+)?\s*:\s*(\d+)\|(\d+)@([01])([+-])\s*)"
+      R"(\(\s*([^,\s]+)\s*,\s*([^)\s]+)\s*\)\s*\[[^\]]*\]\s*"([^"]*)\")");
+
+  std::unordered_map<uint64_t, DbcMessage> messages;
+  DbcMessage *current = nullptr;
+  std::string line;
+  std::smatch match;
+  std::size_t skipped = 0;
+
+  while (std::getline(file, line)) {
+    if (std::regex_search(line, match, messagePattern)) {
+      DbcMessage message;
+      try {
+        auto rawValue = std::stoull(match[1]);
+        if (rawValue > UINT32_MAX) {
+          throw std::out_of_range("message ID");
+        }
+        auto rawId = static_cast<uint32_t>(rawValue);
+        message.extended = (rawId & DbcExtendedFlag) != 0;
+        message.id = rawId & ~DbcExtendedFlag;
+        message.length = static_cast<uint8_t>(std::stoul(match[3]));
+      } catch (const std::logic_error &) {
+        // Out-of-range numbers; the signals below are dropped with it
+        spdlog::warn("Skipping message {}: invalid ID or length",
+                     match[2].str());
+        current = nullptr;
+        continue;
+      }
+      message.name = match[2];
+
+      auto &stored = messages[key(message.id, message.extended)];
+      stored = std::move(message);
+      current = &stored;
+      continue;
+    }
+
+    if (!std::regex_search(line, match, signalPattern)) {
+      // Signals belong to the BO_ block directly above them
+      if (line.find_first_not_of(" \t\r") == std::string::npos) {
+        current = nullptr;
+      }
+      continue;
+    }
+
+    if (current == nullptr) {
+      continue;
+    }
+
+    DbcSignal signal;
+    signal.name = match[1];
+    signal.bigEndian = match[5] == "0";
+    signal.isSigned = match[6] == "-";
+    signal.unit = match[9];
+
+    const std::string multiplex = match[2];
+    try {
+      signal.startBit = static_cast<uint32_t>(std::stoul(match[3]));
+      signal.length = static_cast<uint32_t>(std::stoul(match[4]));
+      signal.scale = std::stod(match[7]);
+      signal.offset = std::stod(match[8]);
+      if (multiplex.size() > 1) {
+        signal.multiplexValue = std::stoll(multiplex.substr(1));
+      }
+    } catch (const std::logic_error &) {
+      // Malformed or out-of-range numbers (e.g. "(abc,0)" or "1e999")
+      spdlog::warn("Skipping signal {}.{}: invalid number", current->name,
+                   signal.name);
+      ++skipped;
+      continue;
+    }
+
+    if (!compile(signal)) {
+      spdlog::warn("Skipping signal {}.{}: layout does not fit 8 bytes",
+                   current->name, signal.name);
+      ++skipped;
+      continue;
+    }
+
+    if (multiplex == "M") {
+      current->multiplexor = static_cast<int>(current->signalList.size());
+    }
+    current->signalIndex[signal.name] = current->signalList.size();
+    current->signalList.push_back(std::move(signal));
+  }
+
+  m_messages = std::move(messages);
+  spdlog::info("Loaded DBC file {}: {} messages, {} signals skipped",
+               filename, m_messages.size(), skipped);
+  return true;
+}
+
+void DbcDatabase::clear() { m_messages.clear(); }
+
+bool DbcDatabase::empty() const { return m_messages.empty(); }
+
+const DbcMessage *DbcDatabase::findMessage(uint32_t id, bool extended) const {
+  auto it = m_messages.find(key(id, extended));
+  if (it == m_messages.end()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+int64_t DbcDatabase::extractRaw(const DbcSignal &signal,
+                                const std::vector<uint8_t> &data) {
+  uint64_t word = signal.bigEndian ? loadBigEndian(data)
+                                   : loadLittleEndian(data);
+  uint64_t raw = (word >> signal.shift) & signal.mask;
+
+  if (signal.isSigned && signal.length < 64 &&
+      (raw & (uint64_t{1} << (signal.length - 1))) != 0) {
+    raw |= ~signal.mask;
+  }
+
+  return static_cast<int64_t>(raw);
+}
+
+double DbcDatabase::decode(const DbcSignal &signal,
+                           const std::vector<uint8_t> &data) {
+  double raw = signal.isSigned
+                   ? static_cast<double>(extractRaw(signal, data))
+                   : static_cast<double>(
+                         static_cast<uint64_t>(extractRaw(signal, data)));
+  return raw * signal.scale + signal.offset;
+}
+
+void DbcDatabase::encode(const DbcSignal &signal, double value,
+                         std::vector<uint8_t> &data) {
+  if (data.size() < 8) {
+    data.resize(8, 0);
+  }
+
+  double scale = signal.scale != 0.0 ? signal.scale : 1.0;
+  auto raw = static_cast<uint64_t>(std::llround((value - signal.offset) / scale));
+
+  uint64_t word = signal.bigEndian ? loadBigEndian(data)
+                                   : loadLittleEndian(data);
+  word &= ~(signal.mask << signal.shift);
+  word |= (raw & signal.mask) << signal.shift;
+
+  if (signal.bigEndian) {
+    storeBigEndian(word, data);
+  } else {
+    storeLittleEndian(word, data);
+  }
+}
+
+bool DbcDatabase::compile(DbcSignal &signal) {
+  if (signal.length == 0 || signal.length > 64) {
+    return false;
+  }
+
+  signal.mask = signal.length == 64 ? ~uint64_t{0}
+                                    : (uint64_t{1} << signal.length) - 1;
+
+  if (!signal.bigEndian) {
+    // Intel: start bit is the LSB, counted from bit 0 of byte 0
+    if (signal.startBit + signal.length > 64) {
+      return false;
+    }
+    signal.shift = signal.startBit;
+    return true;
+  }
+
+  // Motorola: start bit is the MSB in sawtooth numbering. In a big-endian
+  // word, bit k of byte b sits at position (7 - b) * 8 + k.
+  if (signal.startBit >= 64) {
+    return false;
+  }
+  uint32_t msb = (7 - signal.startBit / 8) * 8 + signal.startBit % 8;
+  if (msb + 1 < signal.length) {
+    return false;
+  }
+  signal.shift = msb + 1 - signal.length;
+  return true;
+}
+
+uint64_t DbcDatabase::key(uint32_t id, bool extended) {
+  return static_cast<uint64_t>(extended) << 32 | id;
+}
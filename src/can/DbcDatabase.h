@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Signal layout from a DBC file, compiled into a shift/mask extractor that
+// works on the first 8 bytes of a frame loaded as one 64-bit word
+struct DbcSignal {
+  std::string name;
+  std::string unit;
+  uint32_t startBit = 0;
+  uint32_t length = 0;
+  bool bigEndian = false;
+  bool isSigned = false;
+  double scale = 1.0;
+  double offset = 0.0;
+
+  // -1 for plain signals, otherwise the multiplexor value selecting it
+  int64_t multiplexValue = -1;
+
+  // Compiled extractor
+  uint32_t shift = 0;
+  uint64_t mask = 0;
+};
+
+struct DbcMessage {
+  uint32_t id = 0;
+  bool extended = false;
+  std::string name;
+  uint8_t length = 0;
+  std::vector<DbcSignal> signalList;
+  std::unordered_map<std::string, std::size_t> signalIndex;
+
+  // Index of the multiplexor signal, -1 if the message is not multiplexed
+  int multiplexor = -1;
+
+  const DbcSignal *findSignal(const std::string &name) const;
+
+  // Whether the signal is present in a frame with this payload
+  bool isActive(const DbcSignal &signal,
+                const std::vector<uint8_t> &data) const;
+};
+
+class DbcDatabase {
+public:
+  // Parse a DBC file, replacing anything loaded before
+  bool load(const std::string &filename);
+  void clear();
+  bool empty() const;
+
+  const DbcMessage *findMessage(uint32_t id, bool extended) const;
+
+  // Raw (sign-extended) and physical value of a signal in the given payload
+  static int64_t extractRaw(const DbcSignal &signal,
+                            const std::vector<uint8_t> &data);
+  static double decode(const DbcSignal &signal,
+                       const std::vector<uint8_t> &data);
+
+  // Write a physical value into the payload, growing it to 8 bytes if needed
+  static void encode(const DbcSignal &signal, double value,
+                     std::vector<uint8_t> &data);
+
+private:
+  static bool compile(DbcSignal &signal);
+  static uint64_t key(uint32_t id, bool extended);
+
+  std::unordered_map<uint64_t, DbcMessage> m_messages;
+};
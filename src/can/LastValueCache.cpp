@@ -0,0 +1,48 @@
+#include "LastValueCache.h"
+
+void LastValueCache::update(const CanMessage &message) {
+  const uint32_t id = message.getID();
+
+  if (!message.isExtended() && id < StandardIdCount) {
+    m_standard[id] = message;
+    if (!m_standardValid.test(id)) {
+      m_standardValid.set(id);
+      m_order.push_back(&m_standard[id]);
+    }
+    return;
+  }
+
+  auto [it, inserted] = m_hashed.try_emplace(key(id, message.isExtended()));
+  it->second = message;
+  if (inserted) {
+    m_order.push_back(&it->second);
+  }
+}
+
+const CanMessage *LastValueCache::find(uint32_t id, bool extended) const {
+  if (!extended && id < StandardIdCount) {
+    return m_standardValid.test(id) ? &m_standard[id] : nullptr;
+  }
+
+  auto it = m_hashed.find(key(id, extended));
+  if (it == m_hashed.end()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+void LastValueCache::snapshot(std::vector<const CanMessage *> &messages) const {
+  messages.assign(m_order.begin(), m_order.end());
+}
+
+std::size_t LastValueCache::size() const { return m_order.size(); }
+
+void LastValueCache::clear() {
+  m_standardValid.reset();
+  m_hashed.clear();
+  m_order.clear();
+}
+
+uint64_t LastValueCache::key(uint32_t id, bool extended) {
+  return static_cast<uint64_t>(extended) << 32 | id;
+}
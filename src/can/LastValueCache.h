@@ -0,0 +1,38 @@
+#pragma once
+
+#include <can/CanMessage.h>
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Latest frame seen for every CAN ID.
+//
+// Standard 11-bit IDs live in a dense table indexed by ID, everything else
+// (29-bit IDs) in a hash map. Updating an existing entry reuses its payload
+// storage, so steady-state updates do not allocate.
+class LastValueCache {
+public:
+  void update(const CanMessage &message);
+  const CanMessage *find(uint32_t id, bool extended) const;
+
+  // All cached frames, in the order their IDs were first seen
+  void snapshot(std::vector<const CanMessage *> &messages) const;
+
+  std::size_t size() const;
+  void clear();
+
+private:
+  static constexpr std::size_t StandardIdCount = 0x800;
+
+  static uint64_t key(uint32_t id, bool extended);
+
+  std::array<CanMessage, StandardIdCount> m_standard;
+  std::bitset<StandardIdCount> m_standardValid;
+  std::unordered_map<uint64_t, CanMessage> m_hashed;
+
+  // Insertion order, used to walk the cache without scanning empty slots
+  std::vector<const CanMessage *> m_order;
+};
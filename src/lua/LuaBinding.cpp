@@ -2,27 +2,40 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <chrono>
+#include <csignal>
 
 LuaBinding::LuaBinding(asio::io_context &ioContext)
     : m_ioContext(ioContext),
       m_workGuard(std::make_unique<
                   asio::executor_work_guard<asio::io_context::executor_type>>(
           ioContext.get_executor())),
-      m_queueProcessing(true) {
+      m_hooks(m_lua.lua_state()), m_profiler(m_hooks), m_watchdog(m_hooks),
+      m_profileSignals(ioContext),
+      m_outboundCount(0), m_signalDecoding(true), m_currentMessage(nullptr),
+      m_eventSlice(static_cast<uint64_t>(DefaultEventSliceMilliseconds * 1e6)),
+      m_sliceStart(0), m_sliceBusy(0), m_drainScheduled(false) {
 
   // Initialize Lua
   m_lua.open_libraries(sol::lib::base, sol::lib::package, sol::lib::coroutine,
                        sol::lib::string, sol::lib::math, sol::lib::table,
                        sol::lib::io, sol::lib::os);
+  m_hooks.trackCoroutines();
 
   registerFunctions();
+
+#ifdef SIGUSR1
+  // SIGUSR1 starts the sampling profiler, the next one stops it and dumps
+  // the samples
+  m_profileSignals.add(SIGUSR1);
+  waitForProfileSignal();
+#endif
 }
 
 LuaBinding::~LuaBinding() {
+  m_profileSignals.cancel();
   stopServer();
-  m_queueProcessing = false;
-  m_queueCV.notify_all();
   m_workGuard.reset();
 }
 
@@ -79,8 +92,62 @@ void LuaBinding::registerFunctions() {
   m_lua.set_function("sendCANMessage", &LuaBinding::sendCanMessage, this);
   m_lua.set_function("broadcastCANMessage", &LuaBinding::broadcastCanMessage,
                      this);
+  m_lua.set_function("sendCANMessages", &LuaBinding::sendCanMessages, this);
+  m_lua.set_function("broadcastCANMessages",
+                     &LuaBinding::broadcastCanMessages, this);
   m_lua.set_function("getConnectedClients", &LuaBinding::getConnectedClients,
                      this);
+  m_lua.set_function("getSessionPoolStats", &LuaBinding::getSessionPoolStats,
+                     this);
+  m_lua.set_function("getSubscriptions", &LuaBinding::getSubscriptions, this);
+  m_lua.set_function("setSubscriptions", &LuaBinding::setSubscriptions, this);
+  m_lua.set_function("setWireTimestamps", &LuaBinding::setWireTimestamps,
+                     this);
+  m_lua.set_function("setRateLimit", &LuaBinding::setRateLimit, this);
+  m_lua.set_function("setClientRateLimit", &LuaBinding::setClientRateLimit,
+                     this);
+  m_lua.set_function("clearClientRateLimit",
+                     &LuaBinding::clearClientRateLimit, this);
+  m_lua.set_function("getRateLimitStats", &LuaBinding::getRateLimitStats,
+                     this);
+  m_lua.set_function("addAutoResponse", &LuaBinding::addAutoResponse, this);
+  m_lua.set_function("removeAutoResponse", &LuaBinding::removeAutoResponse,
+                     this);
+  m_lua.set_function("clearAutoResponses", &LuaBinding::clearAutoResponses,
+                     this);
+  m_lua.set_function("getAutoResponseStats",
+                     &LuaBinding::getAutoResponseStats, this);
+  m_lua.set_function("enableShmTap", &LuaBinding::enableShmTap, this);
+  m_lua.set_function("disableShmTap", &LuaBinding::disableShmTap, this);
+  m_lua.set_function("getLastMessage", &LuaBinding::getLastMessage, this);
+  m_lua.set_function("setSnapshotOnConnect", &LuaBinding::setSnapshotOnConnect,
+                     this);
+  m_lua.set_function("getMonotonicTime", &LuaBinding::getMonotonicTime, this);
+
+  // Profiling
+  m_lua.set_function("setCallbackTiming", &LuaBinding::setCallbackTiming,
+                     this);
+  m_lua.set_function("getCallbackStats", &LuaBinding::getCallbackStats, this);
+  m_lua.set_function("resetCallbackStats", &LuaBinding::resetCallbackStats,
+                     this);
+  m_lua.set_function("startProfiler", &LuaBinding::startProfiler, this);
+  m_lua.set_function("stopProfiler", &LuaBinding::stopProfiler, this);
+  m_lua.set_function("dumpProfile", &LuaBinding::dumpProfile, this);
+
+  // Callback budgets and event deferral
+  m_lua.set_function("setCallbackBudget", &LuaBinding::setCallbackBudget,
+                     this);
+  m_lua.set_function("setEventQueue", &LuaBinding::setEventQueue, this);
+  m_lua.set_function("getEventQueueStats", &LuaBinding::getEventQueueStats,
+                     this);
+
+  // DBC signal decoding
+  m_lua.set_function("loadDBC", &LuaBinding::loadDbc, this);
+  m_lua.set_function("setSignalDecoding", &LuaBinding::setSignalDecoding,
+                     this);
+  m_lua.set_function("getSignal", &LuaBinding::getSignal, this);
+  m_lua.set_function("createCANMessageFromSignals",
+                     &LuaBinding::createCanMessageFromSignals, this);
 
   // Logging
   m_lua.set_function("log", &LuaBinding::log, this);
@@ -95,14 +162,23 @@ void LuaBinding::registerFunctions() {
   m_lua["onMessageReceived"] = sol::lua_nil;
 }
 
-void LuaBinding::startServer(uint16_t port) {
+void LuaBinding::startServer(uint16_t port,
+                             sol::optional<std::size_t> maxConnections) {
   if (m_server) {
     spdlog::error("Server already running");
     return;
   }
 
+  std::size_t connections =
+      maxConnections.value_or(TcpServer::DefaultMaxConnections);
+  if (connections == 0 || connections > TcpServer::MaxConnectionsLimit) {
+    spdlog::error("maxConnections must be between 1 and {}",
+                  TcpServer::MaxConnectionsLimit);
+    return;
+  }
+
   try {
-    m_server = std::make_unique<TcpServer>(m_ioContext, port);
+    m_server = std::make_unique<TcpServer>(m_ioContext, port, connections);
 
     m_server->setConnectCallback(
         std::bind(&LuaBinding::onClientConnected, this, std::placeholders::_1));
@@ -131,8 +207,24 @@ void LuaBinding::stopServer() {
 }
 
 std::string LuaBinding::createCanMessage(uint32_t id, const sol::table &data,
-                                         bool extended, bool rtr) {
+                                         bool extended, bool rtr,
+                                         sol::optional<uint64_t> timestamp) {
+  // Create CAN message
+  CanMessage message(id, tableToBytes(data), extended, rtr);
+  message.setTimestamp(timestamp.value_or(0));
+
+  return storeCanMessage(message);
+}
+
+std::vector<uint8_t> LuaBinding::tableToBytes(const sol::table &data) {
   std::vector<uint8_t> bytes;
+  tableToBytes(data, bytes);
+  return bytes;
+}
+
+void LuaBinding::tableToBytes(const sol::table &data,
+                              std::vector<uint8_t> &bytes) {
+  bytes.clear();
   bytes.reserve(data.size());
 
   // Convert table to byte vector
@@ -143,12 +235,29 @@ std::string LuaBinding::createCanMessage(uint32_t id, const sol::table &data,
       bytes.push_back(byte);
     }
   }
+}
 
-  // Create CAN message
-  CanMessage message(id, bytes, extended, rtr);
+std::vector<AutoResponseRule::BytePattern>
+LuaBinding::tableToBytePatterns(const sol::table &bytes) {
+  // Sparse {[position] = value} table with 1-based byte positions
+  std::vector<AutoResponseRule::BytePattern> patterns;
+  for (const auto &[key, value] : bytes) {
+    if (!key.is<int64_t>() || !value.is<int>() || key.as<int64_t>() < 1) {
+      continue;
+    }
+
+    AutoResponseRule::BytePattern pattern;
+    pattern.index = static_cast<std::size_t>(key.as<int64_t>() - 1);
+    pattern.value = static_cast<uint8_t>(value.as<int>() & 0xFF);
+    patterns.push_back(pattern);
+  }
 
+  return patterns;
+}
+
+std::string LuaBinding::storeCanMessage(const CanMessage &message) {
   // Generate a unique ID for this message
-  std::string messageId = "msg_" + std::to_string(id) + "_" +
+  std::string messageId = "msg_" + std::to_string(message.getID()) + "_" +
                           std::to_string(reinterpret_cast<uintptr_t>(&message));
 
   // Store the message
@@ -211,6 +320,155 @@ bool LuaBinding::broadcastCanMessage(const std::string &messageId) {
   return true;
 }
 
+bool LuaBinding::sendCanMessages(const std::string &clientId,
+                                 const sol::object &frames) {
+  if (!m_server) {
+    spdlog::error("Server not running");
+    return false;
+  }
+
+  if (!parseFrames(frames)) {
+    return false;
+  }
+
+  bool success = m_server->sendMessages(clientId, m_outboundBatch.data(),
+                                        m_outboundCount);
+  if (success) {
+    spdlog::debug("Sent {} messages to client {}", m_outboundCount, clientId);
+  } else {
+    spdlog::error("Failed to send messages to client {}", clientId);
+  }
+
+  return success;
+}
+
+bool LuaBinding::broadcastCanMessages(const sol::object &frames) {
+  if (!m_server) {
+    spdlog::error("Server not running");
+    return false;
+  }
+
+  if (!parseFrames(frames)) {
+    return false;
+  }
+
+  m_server->broadcastMessages(m_outboundBatch.data(), m_outboundCount);
+  spdlog::debug("Broadcast {} messages", m_outboundCount);
+
+  return true;
+}
+
+bool LuaBinding::parseFrames(const sol::object &frames) {
+  m_outboundCount = 0;
+
+  if (frames.get_type() == sol::type::string) {
+    return parsePackedFrames(frames.as<std::string_view>());
+  }
+
+  if (frames.get_type() != sol::type::table) {
+    spdlog::error("Frames must be a table or a packed string");
+    return false;
+  }
+
+  sol::table list = frames.as<sol::table>();
+  for (std::size_t i = 1; i <= list.size(); ++i) {
+    sol::object frame = list[i];
+
+    bool valid = false;
+    if (frame.get_type() == sol::type::string) {
+      valid = parsePackedFrames(frame.as<std::string_view>());
+    } else if (frame.get_type() == sol::type::table) {
+      valid = parseFrame(frame.as<sol::table>(), nextBatchMessage());
+    }
+
+    if (!valid) {
+      spdlog::error("Invalid frame at index {}", i);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool LuaBinding::parseFrame(const sol::table &frame, CanMessage &message) {
+  // {id = ..., data = ..., ext = ..., rtr = ...} or {id, data, ext, rtr}
+  auto id = frame.get<sol::optional<uint32_t>>("id");
+  if (!id) {
+    id = frame.get<sol::optional<uint32_t>>(1);
+  }
+  if (!id) {
+    return false;
+  }
+
+  auto data = frame.get<sol::object>("data");
+  if (data.get_type() == sol::type::lua_nil) {
+    data = frame.get<sol::object>(2);
+  }
+
+  if (data.get_type() == sol::type::string) {
+    auto bytes = data.as<std::string_view>();
+    m_byteBuffer.assign(bytes.begin(), bytes.end());
+  } else if (data.get_type() == sol::type::table) {
+    tableToBytes(data.as<sol::table>(), m_byteBuffer);
+  } else {
+    m_byteBuffer.clear();
+  }
+
+  message.setID(*id);
+  message.setData(m_byteBuffer);
+  message.setExtended(frame.get_or("ext", frame.get_or(3, false)));
+  message.setRTR(frame.get_or("rtr", frame.get_or(4, false)));
+  message.setControl(false);
+  message.setTimestamp(
+      frame.get_or("timestamp", frame.get_or(5, uint64_t{0})));
+  return true;
+}
+
+bool LuaBinding::parsePackedFrames(std::string_view packed) {
+  // Frames in wire format: 4-byte big-endian length, then the frame
+  const auto *bytes = reinterpret_cast<const uint8_t *>(packed.data());
+  std::size_t offset = 0;
+
+  while (offset < packed.size()) {
+    if (packed.size() - offset < 4) {
+      return false;
+    }
+
+    uint32_t length = static_cast<uint32_t>(bytes[offset]) << 24 |
+                      static_cast<uint32_t>(bytes[offset + 1]) << 16 |
+                      static_cast<uint32_t>(bytes[offset + 2]) << 8 |
+                      static_cast<uint32_t>(bytes[offset + 3]);
+    offset += 4;
+
+    if (length < 6 || packed.size() - offset < length) {
+      return false;
+    }
+
+    // The payload, and the timestamp if flagged, must fit into the frame
+    std::size_t dataOffset = (bytes[offset + 4] & 0x08) != 0 ? 14 : 6;
+    if (length < dataOffset + bytes[offset + 5]) {
+      return false;
+    }
+
+    // Scripts only send data frames; outbound timestamps are the server's
+    CanMessage &message = nextBatchMessage();
+    message = CanMessage::deserialize(bytes + offset, length);
+    message.setControl(false);
+    message.setTimestamp(0);
+    offset += length;
+  }
+
+  return true;
+}
+
+CanMessage &LuaBinding::nextBatchMessage() {
+  if (m_outboundCount == m_outboundBatch.size()) {
+    m_outboundBatch.emplace_back();
+  }
+
+  return m_outboundBatch[m_outboundCount++];
+}
+
 sol::table LuaBinding::getConnectedClients() {
   sol::table result = m_lua.create_table();
 
@@ -224,6 +482,455 @@ sol::table LuaBinding::getConnectedClients() {
   return result;
 }
 
+sol::table LuaBinding::getSessionPoolStats() {
+  sol::table result = m_lua.create_table(0, 4);
+
+  if (m_server) {
+    auto stats = m_server->getSessionPoolStats();
+    result["capacity"] = stats.capacity;
+    result["inUse"] = stats.inUse;
+    result["peak"] = stats.peak;
+    result["rejected"] = stats.rejected;
+  }
+
+  return result;
+}
+
+sol::object LuaBinding::getSubscriptions(const std::string &clientId) {
+  if (!m_server) {
+    return sol::make_object(m_lua, sol::lua_nil);
+  }
+
+  // nil means the client receives every broadcast
+  auto filters = m_server->getSubscriptions(clientId);
+  if (!filters) {
+    return sol::make_object(m_lua, sol::lua_nil);
+  }
+
+  sol::table result = m_lua.create_table(static_cast<int>(filters->size()), 0);
+  for (size_t i = 0; i < filters->size(); ++i) {
+    sol::table entry = m_lua.create_table(0, 2);
+    entry["id"] = (*filters)[i].id;
+    entry["mask"] = (*filters)[i].mask;
+    result[i + 1] = entry;
+  }
+
+  return result;
+}
+
+bool LuaBinding::setSubscriptions(const std::string &clientId,
+                                  const sol::object &filters) {
+  if (!m_server) {
+    spdlog::error("Server not running");
+    return false;
+  }
+
+  if (filters.get_type() == sol::type::lua_nil) {
+    return m_server->clearSubscriptions(clientId);
+  }
+
+  if (filters.get_type() != sol::type::table) {
+    spdlog::error("setSubscriptions expects a table of filters or nil");
+    return false;
+  }
+
+  // Entries are either plain CAN IDs or {id = ..., mask = ...} tables
+  sol::table filterTable = filters.as<sol::table>();
+  std::vector<CanFilter> parsed;
+  parsed.reserve(filterTable.size());
+
+  for (int i = 1; i <= filterTable.size(); ++i) {
+    sol::object value = filterTable[i];
+    CanFilter filter;
+    if (value.get_type() == sol::type::number) {
+      filter.id = value.as<uint32_t>();
+    } else if (value.get_type() == sol::type::table) {
+      sol::table entry = value.as<sol::table>();
+      filter.id = entry.get_or<uint32_t>("id", 0);
+      filter.mask = entry.get_or<uint32_t>("mask", CanFilter::ExactMask);
+    } else {
+      continue;
+    }
+    parsed.push_back(filter);
+  }
+
+  bool success = m_server->setSubscriptions(clientId, parsed);
+  if (!success) {
+    spdlog::error("Unknown client: {}", clientId);
+  }
+
+  return success;
+}
+
+void LuaBinding::setWireTimestamps(bool enabled) {
+  if (!m_server) {
+    spdlog::error("Server not running");
+    return;
+  }
+
+  m_server->setWireTimestamps(enabled);
+}
+
+bool LuaBinding::parseRateLimit(double framesPerSecond, double bytesPerSecond,
+                                const sol::optional<std::string> &mode,
+                                TcpServer::RateLimit &limit) {
+  limit.framesPerSecond = framesPerSecond;
+  limit.bytesPerSecond = bytesPerSecond;
+
+  const std::string modeName = mode.value_or("drop");
+  if (modeName == "drop") {
+    limit.mode = TcpServer::ThrottleMode::Drop;
+  } else if (modeName == "pause") {
+    limit.mode = TcpServer::ThrottleMode::Pause;
+  } else {
+    spdlog::error("Unknown rate limit mode: {}", modeName);
+    return false;
+  }
+
+  return true;
+}
+
+bool LuaBinding::setRateLimit(double framesPerSecond, double bytesPerSecond,
+                              sol::optional<std::string> mode) {
+  if (!m_server) {
+    spdlog::error("Server not running");
+    return false;
+  }
+
+  TcpServer::RateLimit limit;
+  if (!parseRateLimit(framesPerSecond, bytesPerSecond, mode, limit)) {
+    return false;
+  }
+
+  m_server->setRateLimit(limit);
+  return true;
+}
+
+bool LuaBinding::setClientRateLimit(const std::string &clientId,
+                                    double framesPerSecond,
+                                    double bytesPerSecond,
+                                    sol::optional<std::string> mode) {
+  if (!m_server) {
+    spdlog::error("Server not running");
+    return false;
+  }
+
+  TcpServer::RateLimit limit;
+  if (!parseRateLimit(framesPerSecond, bytesPerSecond, mode, limit)) {
+    return false;
+  }
+
+  bool success = m_server->setClientRateLimit(clientId, limit);
+  if (!success) {
+    spdlog::error("Unknown client: {}", clientId);
+  }
+
+  return success;
+}
+
+bool LuaBinding::clearClientRateLimit(const std::string &clientId) {
+  if (!m_server) {
+    spdlog::error("Server not running");
+    return false;
+  }
+
+  return m_server->setClientRateLimit(clientId, std::nullopt);
+}
+
+sol::object LuaBinding::getRateLimitStats(sol::optional<std::string> clientId) {
+  if (!m_server) {
+    return sol::make_object(m_lua, sol::lua_nil);
+  }
+
+  TcpServer::RateLimitStats stats;
+  if (clientId) {
+    auto clientStats = m_server->getClientRateLimitStats(*clientId);
+    if (!clientStats) {
+      return sol::make_object(m_lua, sol::lua_nil);
+    }
+    stats = *clientStats;
+  } else {
+    stats = m_server->getRateLimitStats();
+  }
+
+  sol::table result = m_lua.create_table(0, 4);
+  result["droppedFrames"] = stats.droppedFrames;
+  result["droppedBytes"] = stats.droppedBytes;
+  result["delayedFrames"] = stats.delayedFrames;
+  result["pauses"] = stats.pauses;
+
+  return result;
+}
+
+sol::object LuaBinding::addAutoResponse(const sol::table &spec) {
+  if (!m_server) {
+    spdlog::error("Server not running");
+    return sol::make_object(m_lua, sol::lua_nil);
+  }
+
+  AutoResponseRule rule;
+  rule.match.id = spec.get_or<uint32_t>("id", 0);
+  rule.match.mask = spec.get_or<uint32_t>("mask", CanFilter::ExactMask);
+  rule.idOffset = spec.get_or<int64_t>("idOffset", 0);
+
+  sol::optional<sol::table> match = spec["match"];
+  if (match) {
+    rule.payload = tableToBytePatterns(*match);
+  }
+
+  sol::optional<uint32_t> replyId = spec["replyId"];
+  if (replyId) {
+    rule.replyId = *replyId;
+  }
+
+  sol::optional<sol::table> data = spec["data"];
+  if (data) {
+    rule.data = tableToBytes(*data);
+  }
+
+  sol::optional<sol::table> patch = spec["patch"];
+  if (patch) {
+    rule.patches = tableToBytePatterns(*patch);
+  }
+
+  // Replies must stay within a CAN FD payload
+  auto outOfRange = [](const AutoResponseRule::BytePattern &pattern) {
+    return pattern.index >= CanMessage::MaxDataLength;
+  };
+  if (std::any_of(rule.payload.begin(), rule.payload.end(), outOfRange) ||
+      std::any_of(rule.patches.begin(), rule.patches.end(), outOfRange) ||
+      (rule.data && rule.data->size() > CanMessage::MaxDataLength)) {
+    spdlog::error("Auto response positions and data must be within {} bytes",
+                  CanMessage::MaxDataLength);
+    return sol::make_object(m_lua, sol::lua_nil);
+  }
+
+  const std::string target = spec.get_or<std::string>("target", "sender");
+  if (target == "broadcast") {
+    rule.target = AutoResponseRule::Target::Broadcast;
+  } else if (target != "sender") {
+    spdlog::error("Unknown auto response target: {}", target);
+    return sol::make_object(m_lua, sol::lua_nil);
+  }
+
+  return sol::make_object(m_lua, m_server->addAutoResponse(rule));
+}
+
+bool LuaBinding::removeAutoResponse(uint32_t ruleId) {
+  if (!m_server) {
+    spdlog::error("Server not running");
+    return false;
+  }
+
+  return m_server->removeAutoResponse(ruleId);
+}
+
+void LuaBinding::clearAutoResponses() {
+  if (m_server) {
+    m_server->clearAutoResponses();
+  }
+}
+
+sol::table LuaBinding::getAutoResponseStats() {
+  sol::table result = m_lua.create_table();
+
+  if (m_server) {
+    for (const auto &[ruleId, hits] : m_server->getAutoResponseHits()) {
+      result[ruleId] = hits;
+    }
+  }
+
+  return result;
+}
+
+sol::object LuaBinding::getLastMessage(uint32_t id,
+                                       sol::optional<bool> extended) {
+  if (!m_server) {
+    return sol::make_object(m_lua, sol::lua_nil);
+  }
+
+  auto message = m_server->getLastMessage(id, extended.value_or(false));
+  if (!message) {
+    return sol::make_object(m_lua, sol::lua_nil);
+  }
+
+  sol::table result = m_lua.create_table(0, 5);
+  result["id"] = message->getID();
+  result["data"] = createDataTable(message->getData());
+  result["extended"] = message->isExtended();
+  result["rtr"] = message->isRTR();
+  result["timestamp"] = message->getTimestamp();
+
+  return result;
+}
+
+void LuaBinding::setSnapshotOnConnect(bool enabled) {
+  if (!m_server) {
+    spdlog::error("Server not running");
+    return;
+  }
+
+  m_server->setSnapshotOnConnect(enabled);
+}
+
+sol::table LuaBinding::createDataTable(const std::vector<uint8_t> &data) {
+  sol::table dataTable = m_lua.create_table(static_cast<int>(data.size()), 0);
+  for (size_t i = 0; i < data.size(); ++i) {
+    dataTable[i + 1] = static_cast<int>(data[i]);
+  }
+  return dataTable;
+}
+
+bool LuaBinding::loadDbc(const std::string &filename) {
+  return m_dbc.load(filename);
+}
+
+void LuaBinding::setSignalDecoding(bool enabled) { m_signalDecoding = enabled; }
+
+sol::object LuaBinding::getSignal(const std::string &name) {
+  // Only meaningful while onMessageReceived is running
+  if (m_currentMessage == nullptr) {
+    return sol::make_object(m_lua, sol::lua_nil);
+  }
+
+  const DbcMessage *dbcMessage = m_dbc.findMessage(
+      m_currentMessage->getID(), m_currentMessage->isExtended());
+  if (dbcMessage == nullptr) {
+    return sol::make_object(m_lua, sol::lua_nil);
+  }
+
+  const DbcSignal *signal = dbcMessage->findSignal(name);
+  const auto &data = m_currentMessage->getData();
+  if (signal == nullptr || !dbcMessage->isActive(*signal, data)) {
+    return sol::make_object(m_lua, sol::lua_nil);
+  }
+
+  return sol::make_object(m_lua, DbcDatabase::decode(*signal, data));
+}
+
+std::string
+LuaBinding::createCanMessageFromSignals(uint32_t id,
+                                        const sol::table &signalValues,
+                                        sol::optional<bool> extended) {
+  bool isExtended = extended.value_or(false);
+  const DbcMessage *dbcMessage = m_dbc.findMessage(id, isExtended);
+  if (dbcMessage == nullptr) {
+    spdlog::error("Message 0x{:X} not found in DBC", id);
+    return "";
+  }
+
+  // Signals not given in the table stay zero
+  std::vector<uint8_t> bytes(8, 0);
+  for (const auto &[key, value] : signalValues) {
+    if (key.get_type() != sol::type::string ||
+        value.get_type() != sol::type::number) {
+      continue;
+    }
+
+    const DbcSignal *signal = dbcMessage->findSignal(key.as<std::string>());
+    if (signal == nullptr) {
+      spdlog::warn("Signal {} not found in message {}", key.as<std::string>(),
+                   dbcMessage->name);
+      continue;
+    }
+
+    DbcDatabase::encode(*signal, value.as<double>(), bytes);
+  }
+  bytes.resize(dbcMessage->length);
+
+  return storeCanMessage(CanMessage(id, bytes, isExtended, false));
+}
+
+sol::table LuaBinding::decodeSignals(const DbcMessage &dbcMessage,
+                                     const std::vector<uint8_t> &data) {
+  sol::table result =
+      m_lua.create_table(0, static_cast<int>(dbcMessage.signalList.size()));
+
+  for (const auto &signal : dbcMessage.signalList) {
+    if (dbcMessage.isActive(signal, data)) {
+      result[signal.name] = DbcDatabase::decode(signal, data);
+    }
+  }
+
+  return result;
+}
+
+bool LuaBinding::enableShmTap(const std::string &name,
+                              sol::optional<std::size_t> slotCount) {
+  if (!m_server) {
+    spdlog::error("Server not running");
+    return false;
+  }
+
+  return m_server->enableTap(name, slotCount.value_or(65536));
+}
+
+void LuaBinding::disableShmTap() {
+  if (m_server) {
+    m_server->disableTap();
+  }
+}
+
+uint64_t LuaBinding::getMonotonicTime() const {
+  return CanMessage::currentTimestamp();
+}
+
+void LuaBinding::setCallbackTiming(bool enabled) {
+  m_profiler.setTimingEnabled(enabled);
+}
+
+sol::table LuaBinding::getCallbackStats() {
+  sol::table stats = m_lua.create_table();
+
+  for (std::size_t i = 0;
+       i < static_cast<std::size_t>(LuaProfiler::Callback::Count); ++i) {
+    auto callback = static_cast<LuaProfiler::Callback>(i);
+    const auto &histogram = m_profiler.getHistogram(callback);
+
+    sol::table entry = m_lua.create_table();
+    entry["count"] = histogram.count();
+    entry["totalNs"] = histogram.total();
+    entry["maxNs"] = histogram.max();
+    entry["p50Ns"] = histogram.percentile(0.50);
+    entry["p90Ns"] = histogram.percentile(0.90);
+    entry["p99Ns"] = histogram.percentile(0.99);
+    stats[LuaProfiler::callbackName(callback)] = entry;
+  }
+
+  return stats;
+}
+
+void LuaBinding::resetCallbackStats() { m_profiler.resetTiming(); }
+
+void LuaBinding::startProfiler(sol::optional<int> instructionPeriod) {
+  m_profiler.resetSamples();
+  m_profiler.startSampling(
+      instructionPeriod.value_or(DefaultProfilerPeriod));
+}
+
+void LuaBinding::stopProfiler() { m_profiler.stopSampling(); }
+
+bool LuaBinding::dumpProfile(const std::string &filename) {
+  return m_profiler.dumpFoldedStacks(filename);
+}
+
+void LuaBinding::waitForProfileSignal() {
+  m_profileSignals.async_wait([this](const std::error_code &error, int) {
+    if (error) {
+      return;
+    }
+
+    if (m_profiler.isSampling()) {
+      m_profiler.stopSampling();
+      m_profiler.dumpFoldedStacks(DefaultProfileFile);
+    } else {
+      startProfiler(sol::nullopt);
+    }
+
+    waitForProfileSignal();
+  });
+}
+
 void LuaBinding::log(const std::string &message) const {
   spdlog::info("[LUA] - {}", message);
 }
@@ -239,90 +946,190 @@ void LuaBinding::wait(int milliseconds) {
   timer.wait();
 }
 
+void LuaBinding::setCallbackBudget(uint64_t instructions,
+                                   double milliseconds) {
+  LuaWatchdog::Budget budget;
+  budget.instructions = instructions;
+  budget.nanoseconds =
+      milliseconds > 0 ? static_cast<uint64_t>(milliseconds * 1e6) : 0;
+  m_watchdog.setBudget(budget);
+}
+
+bool LuaBinding::setEventQueue(std::size_t capacity,
+                               sol::optional<std::string> shed,
+                               sol::optional<double> sliceMilliseconds) {
+  auto policy = LuaEventQueue::ShedPolicy::DropNewest;
+  if (shed) {
+    if (*shed == "drop-oldest") {
+      policy = LuaEventQueue::ShedPolicy::DropOldest;
+    } else if (*shed != "drop-newest") {
+      spdlog::error("Unknown shed policy: {}", *shed);
+      return false;
+    }
+  }
+
+  double slice = sliceMilliseconds.value_or(DefaultEventSliceMilliseconds);
+  if (slice <= 0) {
+    spdlog::error("Event slice must be positive");
+    return false;
+  }
+
+  m_events.configure(capacity, policy);
+  m_eventSlice = static_cast<uint64_t>(slice * 1e6);
+  return true;
+}
+
+sol::table LuaBinding::getEventQueueStats() {
+  auto stats = m_events.getStats();
+
+  sol::table result = m_lua.create_table(0, 5);
+  result["queued"] = stats.queued;
+  result["peak"] = stats.peak;
+  result["deferred"] = stats.deferred;
+  result["dropped"] = stats.dropped;
+  result["aborted"] = m_watchdog.getAbortCount();
+  return result;
+}
+
 void LuaBinding::onClientConnected(const std::string &clientId) {
-  // Add to queue for Lua to process
-  {
-    std::scoped_lock lock(m_queueMutex);
-    m_connectedClients.push(clientId);
+  dispatchEvent(LuaProfiler::Callback::ClientConnected, clientId, nullptr);
+}
+
+void LuaBinding::onClientDisconnected(const std::string &clientId) {
+  dispatchEvent(LuaProfiler::Callback::ClientDisconnected, clientId, nullptr);
+}
+
+void LuaBinding::onMessageReceived(const std::string &clientId,
+                                   const CanMessage &message) {
+  dispatchEvent(LuaProfiler::Callback::MessageReceived, clientId, &message);
+}
+
+void LuaBinding::dispatchEvent(LuaProfiler::Callback callback,
+                               const std::string &clientId,
+                               const CanMessage *message) {
+  // Without a queue every event is handled inline, after anything still
+  // queued from before the queue was turned off.
+  // Connects are never deferred either: the server sends the snapshot right
+  // after the connect callback, so subscriptions made there must be in
+  // place. A client's messages and disconnect come after its connect, so
+  // their order is kept.
+  if (m_events.capacity() == 0 ||
+      callback == LuaProfiler::Callback::ClientConnected) {
+    if (m_events.capacity() == 0) {
+      flushEvents();
+    }
+    invokeCallback(callback, clientId, message);
+    return;
   }
 
-  // Notify about new event
-  m_queueCV.notify_one();
+  // Inline while Lua is within its share of the io thread and nothing is
+  // waiting, so events stay in order
+  if (m_events.empty()) {
+    uint64_t now = CanMessage::currentTimestamp();
+    if (now - m_sliceStart >= 2 * m_eventSlice) {
+      m_sliceStart = now;
+      m_sliceBusy = 0;
+    }
 
-  // Check if Lua has a callback for this event
-  sol::protected_function callback = m_lua["onClientConnected"];
-  if (callback.valid()) {
-    try {
-      sol::protected_function_result result = callback(clientId);
-      if (!result.valid()) {
-        sol::error error = result;
-        spdlog::error("Error in onClientConnected callback: {}", error.what());
-      }
-    } catch (const sol::error &error) {
-      spdlog::error("Exception in onClientConnected callback: {}",
-                    error.what());
+    if (m_sliceBusy < m_eventSlice) {
+      invokeCallback(callback, clientId, message);
+      m_sliceBusy += CanMessage::currentTimestamp() - now;
+      return;
     }
   }
+
+  m_events.push(callback, clientId, message);
+  scheduleEventDrain();
 }
 
-void LuaBinding::onClientDisconnected(const std::string &clientId) {
-  // Add to queue for Lua to process
-  {
-    std::scoped_lock lock(m_queueMutex);
-    m_disconnectedClients.push(clientId);
+void LuaBinding::scheduleEventDrain() {
+  if (m_drainScheduled || m_events.empty()) {
+    return;
   }
 
-  // Notify about new event
-  m_queueCV.notify_one();
+  // Posted behind the handlers already waiting, so reads and accepts get
+  // their turn between slices
+  m_drainScheduled = true;
+  asio::post(m_ioContext, [this]() { drainEvents(); });
+}
 
-  // Check if Lua has a callback for this event
-  sol::protected_function callback = m_lua["onClientDisconnected"];
-  if (callback.valid()) {
-    try {
-      sol::protected_function_result result = callback(clientId);
-      if (!result.valid()) {
-        sol::error error = result;
-        spdlog::error("Error in onClientDisconnected callback: {}",
-                      error.what());
-      }
-    } catch (const sol::error &e) {
-      spdlog::error("Exception in onClientDisconnected callback: {}", e.what());
-    }
+void LuaBinding::drainEvents() {
+  m_drainScheduled = false;
+
+  uint64_t start = CanMessage::currentTimestamp();
+  uint64_t now = start;
+  LuaEvent event;
+  while (now - start < m_eventSlice && m_events.pop(event)) {
+    invokeCallback(event.callback, event.clientId, &event.message);
+    now = CanMessage::currentTimestamp();
   }
+
+  m_sliceStart = start;
+  m_sliceBusy = now - start;
+  scheduleEventDrain();
 }
 
-void LuaBinding::onMessageReceived(const std::string &clientId,
-                                   const CanMessage &message) {
-  // Add to queue for Lua to process
-  {
-    std::scoped_lock lock(m_queueMutex);
-    m_receivedMessages.push({clientId, message});
+void LuaBinding::flushEvents() {
+  LuaEvent event;
+  while (m_events.pop(event)) {
+    invokeCallback(event.callback, event.clientId, &event.message);
   }
+}
 
-  // Notify about new event
-  m_queueCV.notify_one();
+void LuaBinding::invokeCallback(LuaProfiler::Callback callback,
+                                const std::string &clientId,
+                                const CanMessage *message) {
+  const char *name = LuaProfiler::callbackName(callback);
 
   // Check if Lua has a callback for this event
-  sol::protected_function callback = m_lua["onMessageReceived"];
-  if (callback.valid()) {
-    try {
-      // Convert CAN message data to Lua table
-      sol::table dataTable = m_lua.create_table();
-      const auto &data = message.getData();
-      for (size_t i = 0; i < data.size(); ++i) {
-        dataTable[i + 1] = static_cast<int>(data[i]);
-      }
+  sol::protected_function function = m_lua[name];
+  if (!function.valid()) {
+    return;
+  }
 
-      sol::protected_function_result result =
-          callback(clientId, message.getID(), dataTable, message.isExtended(),
-                   message.isRTR());
+  auto start = m_profiler.startTiming();
+  m_watchdog.arm();
+  try {
+    sol::protected_function_result result =
+        callback == LuaProfiler::Callback::MessageReceived
+            ? callMessageReceived(function, clientId, *message)
+            : function(clientId);
 
-      if (!result.valid()) {
-        sol::error error = result;
-        spdlog::error("Error in onMessageReceived callback: {}", error.what());
+    if (!result.valid()) {
+      sol::error error = result;
+      if (m_watchdog.tripped()) {
+        spdlog::warn("{} callback aborted: {}", name, error.what());
+      } else {
+        spdlog::error("Error in {} callback: {}", name, error.what());
       }
-    } catch (const sol::error &error) {
-      spdlog::error("Exception in onMessageReceived callback: ", error.what());
     }
+  } catch (const sol::error &error) {
+    spdlog::error("Exception in {} callback: {}", name, error.what());
   }
-}
\ No newline at end of file
+  m_watchdog.disarm();
+  m_currentMessage = nullptr;
+  m_profiler.stopTiming(callback, start);
+}
+
+sol::protected_function_result
+LuaBinding::callMessageReceived(const sol::protected_function &callback,
+                                const std::string &clientId,
+                                const CanMessage &message) {
+  // Convert CAN message data to Lua table
+  const auto &data = message.getData();
+  sol::table dataTable = createDataTable(data);
+
+  // Decoded signals, if the DBC describes this message
+  sol::object signalTable = sol::make_object(m_lua, sol::lua_nil);
+  const DbcMessage *dbcMessage =
+      m_signalDecoding
+          ? m_dbc.findMessage(message.getID(), message.isExtended())
+          : nullptr;
+  if (dbcMessage != nullptr) {
+    signalTable = decodeSignals(*dbcMessage, data);
+  }
+
+  m_currentMessage = &message;
+  return callback(clientId, message.getID(), dataTable, message.isExtended(),
+                  message.isRTR(), message.getTimestamp(), signalTable);
+}
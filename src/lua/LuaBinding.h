@@ -1,17 +1,21 @@
 #pragma once
 
 #include <can/CanMessage.h>
+#include <can/DbcDatabase.h>
+#include <lua/LuaEventQueue.h>
+#include <lua/LuaHooks.h>
+#include <lua/LuaProfiler.h>
+#include <lua/LuaWatchdog.h>
 #include <tcp/TcpServer.h>
 
 #include <asio.hpp>
 #include <sol/sol.hpp>
 
-#include <condition_variable>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
+#include <string_view>
 
 class LuaBinding {
 public:
@@ -29,14 +33,87 @@ public:
 
 private:
   // TCP server management
-  void startServer(uint16_t port);
+  void startServer(uint16_t port, sol::optional<std::size_t> maxConnections);
   void stopServer();
   std::string createCanMessage(uint32_t id, const sol::table &data,
-                               bool extended, bool rtr);
+                               bool extended, bool rtr,
+                               sol::optional<uint64_t> timestamp);
+  std::string storeCanMessage(const CanMessage &message);
+  static std::vector<uint8_t> tableToBytes(const sol::table &data);
+  static void tableToBytes(const sol::table &data, std::vector<uint8_t> &bytes);
+  static std::vector<AutoResponseRule::BytePattern>
+  tableToBytePatterns(const sol::table &bytes);
   bool sendCanMessage(const std::string &clientId,
                       const std::string &messageId);
   bool broadcastCanMessage(const std::string &messageId);
+  bool sendCanMessages(const std::string &clientId, const sol::object &frames);
+  bool broadcastCanMessages(const sol::object &frames);
+  bool parseFrames(const sol::object &frames);
+  bool parseFrame(const sol::table &frame, CanMessage &message);
+  bool parsePackedFrames(std::string_view packed);
+  CanMessage &nextBatchMessage();
   sol::table getConnectedClients();
+  sol::table getSessionPoolStats();
+  sol::object getSubscriptions(const std::string &clientId);
+  bool setSubscriptions(const std::string &clientId,
+                        const sol::object &filters);
+  void setWireTimestamps(bool enabled);
+  bool enableShmTap(const std::string &name,
+                    sol::optional<std::size_t> slotCount);
+  void disableShmTap();
+
+  // Native auto-responder rules
+  sol::object addAutoResponse(const sol::table &spec);
+  bool removeAutoResponse(uint32_t ruleId);
+  void clearAutoResponses();
+  sol::table getAutoResponseStats();
+
+  // Inbound rate limiting
+  bool setRateLimit(double framesPerSecond, double bytesPerSecond,
+                    sol::optional<std::string> mode);
+  bool setClientRateLimit(const std::string &clientId, double framesPerSecond,
+                          double bytesPerSecond,
+                          sol::optional<std::string> mode);
+  bool clearClientRateLimit(const std::string &clientId);
+  sol::object getRateLimitStats(sol::optional<std::string> clientId);
+  static bool parseRateLimit(double framesPerSecond, double bytesPerSecond,
+                             const sol::optional<std::string> &mode,
+                             TcpServer::RateLimit &limit);
+
+  sol::object getLastMessage(uint32_t id, sol::optional<bool> extended);
+  void setSnapshotOnConnect(bool enabled);
+  sol::table createDataTable(const std::vector<uint8_t> &data);
+
+  // DBC signal decoding
+  bool loadDbc(const std::string &filename);
+  void setSignalDecoding(bool enabled);
+  sol::object getSignal(const std::string &name);
+  std::string createCanMessageFromSignals(uint32_t id,
+                                          const sol::table &signalValues,
+                                          sol::optional<bool> extended);
+  sol::table decodeSignals(const DbcMessage &dbcMessage,
+                           const std::vector<uint8_t> &data);
+
+  // Timing
+  uint64_t getMonotonicTime() const;
+
+  // Callback latency accounting and sampling profiler
+  static constexpr int DefaultProfilerPeriod = 1000;
+  static constexpr const char *DefaultProfileFile = "lua_profile.folded";
+  void setCallbackTiming(bool enabled);
+  sol::table getCallbackStats();
+  void resetCallbackStats();
+  void startProfiler(sol::optional<int> instructionPeriod);
+  void stopProfiler();
+  bool dumpProfile(const std::string &filename);
+  void waitForProfileSignal();
+
+  // Callback budgets and deferral of events while Lua is overloaded
+  static constexpr double DefaultEventSliceMilliseconds = 2.0;
+  void setCallbackBudget(uint64_t instructions, double milliseconds);
+  bool setEventQueue(std::size_t capacity, sol::optional<std::string> shed,
+                     sol::optional<double> sliceMilliseconds);
+  sol::table getEventQueueStats();
 
   // Logging
   void log(const std::string &message) const;
@@ -50,6 +127,16 @@ private:
   void onClientDisconnected(const std::string &clientId);
   void onMessageReceived(const std::string &clientId,
                          const CanMessage &message);
+  void dispatchEvent(LuaProfiler::Callback callback,
+                     const std::string &clientId, const CanMessage *message);
+  void scheduleEventDrain();
+  void drainEvents();
+  void flushEvents();
+  void invokeCallback(LuaProfiler::Callback callback,
+                      const std::string &clientId, const CanMessage *message);
+  sol::protected_function_result
+  callMessageReceived(const sol::protected_function &callback,
+                      const std::string &clientId, const CanMessage &message);
 
   // IO context and work guard to keep IO running
   asio::io_context &m_ioContext;
@@ -59,6 +146,12 @@ private:
   // Lua state
   sol::state m_lua;
 
+  // Instrumentation sharing the state's count hook; SIGUSR1 toggles sampling
+  LuaHooks m_hooks;
+  LuaProfiler m_profiler;
+  LuaWatchdog m_watchdog;
+  asio::signal_set m_profileSignals;
+
   // TCP Server
   std::unique_ptr<TcpServer> m_server;
 
@@ -66,15 +159,22 @@ private:
   std::unordered_map<std::string, CanMessage> m_canMessages;
   std::mutex m_messagesMutex;
 
-  // Message queues for async handling
-  struct ReceivedMessage {
-    std::string clientId;
-    CanMessage message;
-  };
-  std::queue<ReceivedMessage> m_receivedMessages;
-  std::queue<std::string> m_connectedClients;
-  std::queue<std::string> m_disconnectedClients;
-  std::mutex m_queueMutex;
-  std::condition_variable m_queueCV;
-  bool m_queueProcessing;
-};
\ No newline at end of file
+  // Frames of the batch being sent; elements and their payload storage are
+  // reused across batches
+  std::vector<CanMessage> m_outboundBatch;
+  std::size_t m_outboundCount;
+  std::vector<uint8_t> m_byteBuffer;
+
+  // DBC database and the message currently handed to onMessageReceived
+  DbcDatabase m_dbc;
+  bool m_signalDecoding;
+  const CanMessage *m_currentMessage;
+
+  // Events deferred while Lua has used up its share of the io thread; Lua
+  // runs inline for at most one slice in every two slices of wall time
+  LuaEventQueue m_events;
+  uint64_t m_eventSlice;
+  uint64_t m_sliceStart;
+  uint64_t m_sliceBusy;
+  bool m_drainScheduled;
+};
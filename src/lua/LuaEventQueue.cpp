@@ -0,0 +1,71 @@
+#include "LuaEventQueue.h"
+
+#include <algorithm>
+
+void LuaEventQueue::configure(std::size_t capacity, ShedPolicy policy) {
+  m_capacity = capacity;
+  m_policy = policy;
+}
+
+std::size_t LuaEventQueue::capacity() const { return m_capacity; }
+
+bool LuaEventQueue::empty() const { return m_events.empty(); }
+
+void LuaEventQueue::clear() { m_events.clear(); }
+
+bool LuaEventQueue::push(LuaProfiler::Callback callback,
+                         const std::string &clientId,
+                         const CanMessage *message) {
+  bool isMessage = callback == LuaProfiler::Callback::MessageReceived;
+  if (isMessage && m_events.size() >= m_capacity && !shed()) {
+    m_stats.dropped++;
+    return false;
+  }
+
+  LuaEvent &event = m_events.emplace_back();
+  event.callback = callback;
+  event.clientId = clientId;
+  if (message != nullptr) {
+    event.message = *message;
+  }
+
+  m_stats.deferred++;
+  m_stats.peak = std::max(m_stats.peak, m_events.size());
+  return true;
+}
+
+bool LuaEventQueue::pop(LuaEvent &event) {
+  if (m_events.empty()) {
+    return false;
+  }
+
+  event = std::move(m_events.front());
+  m_events.pop_front();
+  return true;
+}
+
+LuaEventQueue::Stats LuaEventQueue::getStats() const {
+  Stats stats = m_stats;
+  stats.queued = m_events.size();
+  return stats;
+}
+
+bool LuaEventQueue::shed() {
+  // Make room by dropping the oldest message event
+  if (m_policy != ShedPolicy::DropOldest) {
+    return false;
+  }
+
+  auto it = std::find_if(m_events.begin(), m_events.end(),
+                         [](const LuaEvent &event) {
+                           return event.callback ==
+                                  LuaProfiler::Callback::MessageReceived;
+                         });
+  if (it == m_events.end()) {
+    return false;
+  }
+
+  m_events.erase(it);
+  m_stats.dropped++;
+  return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <can/CanMessage.h>
+#include <lua/LuaProfiler.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// Event waiting for its Lua callback
+struct LuaEvent {
+  LuaProfiler::Callback callback = LuaProfiler::Callback::MessageReceived;
+  std::string clientId;
+  CanMessage message;
+};
+
+// Bounded queue of events deferred while Lua is overloaded.
+//
+// Only message events are shed when the queue is full; connect and
+// disconnect events are always kept so scripts see a consistent client list.
+class LuaEventQueue {
+public:
+  enum class ShedPolicy { DropNewest, DropOldest };
+
+  struct Stats {
+    std::size_t queued = 0;
+    std::size_t peak = 0;
+    uint64_t deferred = 0; // events queued instead of handled inline
+    uint64_t dropped = 0;  // message events shed because the queue was full
+  };
+
+  void configure(std::size_t capacity, ShedPolicy policy);
+  std::size_t capacity() const;
+  bool empty() const;
+  void clear();
+
+  // Queue an event; message may be nullptr for connect/disconnect events.
+  // Returns false if the event itself was shed
+  bool push(LuaProfiler::Callback callback, const std::string &clientId,
+            const CanMessage *message);
+
+  // Move the oldest event into event; false if the queue is empty
+  bool pop(LuaEvent &event);
+
+  Stats getStats() const;
+
+private:
+  bool shed();
+
+  std::deque<LuaEvent> m_events;
+  std::size_t m_capacity = 0;
+  ShedPolicy m_policy = ShedPolicy::DropNewest;
+  Stats m_stats;
+};
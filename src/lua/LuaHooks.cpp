@@ -0,0 +1,162 @@
+#include "LuaHooks.h"
+
+#include <algorithm>
+
+namespace {
+
+// Replaces coroutine.create and coroutine.wrap so that every coroutine is
+// registered; wrap is rebuilt on top of create to get hold of the thread
+const char *const CoroutineTracker = R"(
+local track = ...
+if type(coroutine) ~= "table" then
+  return
+end
+
+local create, resume = coroutine.create, coroutine.resume
+
+coroutine.create = function(f)
+  local co = create(f)
+  track(co)
+  return co
+end
+
+local function unwrap(ok, ...)
+  if not ok then
+    error((...), 0)
+  end
+  return ...
+end
+
+coroutine.wrap = function(f)
+  local co = coroutine.create(f)
+  return function(...)
+    return unwrap(resume(co, ...))
+  end
+end
+)";
+
+} // namespace
+
+LuaHooks::LuaHooks(lua_State *state) : m_state(state), m_period(0) {
+  // The hook finds the dispatcher through the state's extra space, which
+  // coroutines inherit from the main thread
+  *static_cast<LuaHooks **>(lua_getextraspace(m_state)) = this;
+
+  // Weak set of the coroutines that need the hook too
+  lua_newtable(m_state);
+  lua_newtable(m_state);
+  lua_pushliteral(m_state, "k");
+  lua_setfield(m_state, -2, "__mode");
+  lua_setmetatable(m_state, -2);
+  m_threads = luaL_ref(m_state, LUA_REGISTRYINDEX);
+}
+
+LuaHooks::~LuaHooks() {
+  for (auto &entry : m_entries) {
+    entry = Entry{};
+  }
+  install();
+
+  luaL_unref(m_state, LUA_REGISTRYINDEX, m_threads);
+  *static_cast<LuaHooks **>(lua_getextraspace(m_state)) = nullptr;
+}
+
+void LuaHooks::trackCoroutines() {
+  if (luaL_loadstring(m_state, CoroutineTracker) != LUA_OK) {
+    lua_pop(m_state, 1);
+    return;
+  }
+
+  lua_pushcfunction(m_state, &LuaHooks::trackThread);
+  if (lua_pcall(m_state, 1, 0, 0) != LUA_OK) {
+    lua_pop(m_state, 1);
+  }
+}
+
+void LuaHooks::setListener(Slot slot, Listener *listener, int period) {
+  Entry &entry = m_entries[static_cast<std::size_t>(slot)];
+  entry.listener = listener;
+  entry.period = listener != nullptr ? std::max(period, 1) : 0;
+  entry.remaining = entry.period;
+  install();
+}
+
+void LuaHooks::countHook(lua_State *state, lua_Debug *) {
+  auto *hooks = *static_cast<LuaHooks **>(lua_getextraspace(state));
+  if (hooks != nullptr) {
+    hooks->dispatch(state);
+  }
+}
+
+int LuaHooks::trackThread(lua_State *state) {
+  auto *hooks = *static_cast<LuaHooks **>(lua_getextraspace(state));
+  lua_State *thread = lua_tothread(state, 1);
+  if (hooks == nullptr || thread == nullptr) {
+    return 0;
+  }
+
+  lua_rawgeti(state, LUA_REGISTRYINDEX, hooks->m_threads);
+  lua_pushvalue(state, 1);
+  lua_pushboolean(state, 1);
+  lua_rawset(state, -3);
+  lua_pop(state, 1);
+
+  hooks->apply(thread);
+  return 0;
+}
+
+void LuaHooks::dispatch(lua_State *state) {
+  // The thread's own hook count is the number of instructions since the
+  // last call, even if it still runs with an older period
+  int executed = lua_gethookcount(state);
+
+  // Listeners may leave through a Lua error, so each entry is updated
+  // before its listener runs
+  for (auto &entry : m_entries) {
+    if (entry.listener == nullptr) {
+      continue;
+    }
+
+    entry.remaining -= executed;
+    if (entry.remaining <= 0) {
+      entry.remaining += entry.period;
+      if (entry.remaining <= 0) {
+        entry.remaining = entry.period;
+      }
+      entry.listener->onInstructions(state, executed);
+    }
+  }
+}
+
+void LuaHooks::install() {
+  // The hook fires at the shortest period; longer ones are counted down
+  m_period = 0;
+  for (const auto &entry : m_entries) {
+    if (entry.listener != nullptr) {
+      m_period = m_period == 0 ? entry.period : std::min(m_period, entry.period);
+    }
+  }
+
+  apply(m_state);
+
+  // lua_sethook only affects one thread; coroutines keep the settings they
+  // were created with unless they are updated as well
+  lua_rawgeti(m_state, LUA_REGISTRYINDEX, m_threads);
+  lua_pushnil(m_state);
+  while (lua_next(m_state, -2) != 0) {
+    lua_State *thread = lua_tothread(m_state, -2);
+    if (thread != nullptr) {
+      apply(thread);
+    }
+    lua_pop(m_state, 1);
+  }
+  lua_pop(m_state, 1);
+}
+
+void LuaHooks::apply(lua_State *thread) {
+  if (m_period == 0) {
+    lua_sethook(thread, nullptr, 0, 0);
+  } else {
+    lua_sethook(thread, &LuaHooks::countHook, LUA_MASKCOUNT, m_period);
+  }
+}
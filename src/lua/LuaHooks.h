@@ -0,0 +1,55 @@
+#pragma once
+
+#include <sol/sol.hpp>
+
+#include <array>
+#include <cstddef>
+
+// Shares the Lua count hook between several users.
+//
+// A Lua state has a single debug hook, but the sampling profiler and the
+// execution budget both need to run every N instructions. Each registers a
+// listener with its own period; the hook is only installed while at least
+// one listener is registered.
+//
+// lua_sethook only applies to one thread, so coroutines created through
+// coroutine.create/wrap are tracked and updated whenever the hook changes.
+class LuaHooks {
+public:
+  class Listener {
+  public:
+    virtual ~Listener() = default;
+
+    // Called about every period instructions; may raise a Lua error
+    virtual void onInstructions(lua_State *state, int instructions) = 0;
+  };
+
+  enum class Slot { Profiler, Watchdog, Count };
+
+  explicit LuaHooks(lua_State *state);
+  ~LuaHooks();
+
+  // Register new coroutines; call once the coroutine library is open
+  void trackCoroutines();
+
+  // Register a listener for a slot; nullptr removes it
+  void setListener(Slot slot, Listener *listener, int period);
+
+private:
+  struct Entry {
+    Listener *listener = nullptr;
+    int period = 0;
+    int remaining = 0;
+  };
+
+  static void countHook(lua_State *state, lua_Debug *debug);
+  static int trackThread(lua_State *state);
+  void dispatch(lua_State *state);
+  void install();
+  void apply(lua_State *thread);
+
+  lua_State *m_state;
+  std::array<Entry, static_cast<std::size_t>(Slot::Count)> m_entries;
+  int m_period;
+  int m_threads; // registry reference to the weak set of coroutines
+};
@@ -0,0 +1,190 @@
+#include "LuaProfiler.h"
+
+#include <can/CanMessage.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+constexpr int MaxStackDepth = 64;
+
+std::size_t bucketIndex(uint64_t nanoseconds) {
+  std::size_t index = 0;
+  while (nanoseconds != 0) {
+    nanoseconds >>= 1;
+    index++;
+  }
+  return index;
+}
+
+} // namespace
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+  m_buckets[bucketIndex(nanoseconds)]++;
+  m_count++;
+  m_total += nanoseconds;
+  m_max = std::max(m_max, nanoseconds);
+}
+
+void LatencyHistogram::reset() { *this = LatencyHistogram{}; }
+
+uint64_t LatencyHistogram::count() const { return m_count; }
+
+uint64_t LatencyHistogram::total() const { return m_total; }
+
+uint64_t LatencyHistogram::max() const { return m_max; }
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+  if (m_count == 0) {
+    return 0;
+  }
+
+  auto rank = static_cast<uint64_t>(fraction * static_cast<double>(m_count));
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < m_buckets.size(); ++i) {
+    seen += m_buckets[i];
+    if (seen > rank) {
+      // Bucket i holds values below 2^i
+      uint64_t upper = i >= 64 ? m_max : (uint64_t{1} << i) - 1;
+      return std::min(upper, m_max);
+    }
+  }
+
+  return m_max;
+}
+
+LuaProfiler::LuaProfiler(LuaHooks &hooks)
+    : m_hooks(hooks), m_timingEnabled(false), m_sampling(false) {}
+
+LuaProfiler::~LuaProfiler() { stopSampling(); }
+
+const char *LuaProfiler::callbackName(Callback callback) {
+  switch (callback) {
+  case Callback::ClientConnected:
+    return "onClientConnected";
+  case Callback::ClientDisconnected:
+    return "onClientDisconnected";
+  case Callback::MessageReceived:
+    return "onMessageReceived";
+  default:
+    return "unknown";
+  }
+}
+
+void LuaProfiler::setTimingEnabled(bool enabled) { m_timingEnabled = enabled; }
+
+bool LuaProfiler::isTimingEnabled() const { return m_timingEnabled; }
+
+uint64_t LuaProfiler::startTiming() const {
+  return m_timingEnabled ? CanMessage::currentTimestamp() : 0;
+}
+
+void LuaProfiler::stopTiming(Callback callback, uint64_t start) {
+  if (start == 0) {
+    return;
+  }
+
+  m_histograms[static_cast<std::size_t>(callback)].record(
+      CanMessage::currentTimestamp() - start);
+}
+
+const LatencyHistogram &LuaProfiler::getHistogram(Callback callback) const {
+  return m_histograms[static_cast<std::size_t>(callback)];
+}
+
+void LuaProfiler::resetTiming() {
+  for (auto &histogram : m_histograms) {
+    histogram.reset();
+  }
+}
+
+void LuaProfiler::startSampling(int instructionPeriod) {
+  m_hooks.setListener(LuaHooks::Slot::Profiler, this,
+                      std::max(instructionPeriod, 1));
+  m_sampling = true;
+  spdlog::info("Lua profiler started, sampling every {} instructions",
+               instructionPeriod);
+}
+
+void LuaProfiler::stopSampling() {
+  if (!m_sampling) {
+    return;
+  }
+
+  m_hooks.setListener(LuaHooks::Slot::Profiler, nullptr, 0);
+  m_sampling = false;
+  spdlog::info("Lua profiler stopped, {} distinct stacks", m_samples.size());
+}
+
+bool LuaProfiler::isSampling() const { return m_sampling; }
+
+void LuaProfiler::resetSamples() { m_samples.clear(); }
+
+bool LuaProfiler::dumpFoldedStacks(const std::string &filename) const {
+  std::ofstream file(filename);
+  if (!file) {
+    spdlog::error("Cannot write profile to {}", filename);
+    return false;
+  }
+
+  for (const auto &[stack, count] : m_samples) {
+    file << stack << ' ' << count << '\n';
+  }
+
+  spdlog::info("Wrote {} folded stacks to {}", m_samples.size(), filename);
+  return true;
+}
+
+void LuaProfiler::onInstructions(lua_State *state, int) { sample(state); }
+
+void LuaProfiler::sample(lua_State *state) {
+  std::array<lua_Debug, MaxStackDepth> frames;
+  int depth = 0;
+  while (depth < MaxStackDepth && lua_getstack(state, depth, &frames[depth])) {
+    lua_getinfo(state, "Sln", &frames[depth]);
+    depth++;
+  }
+
+  if (depth == 0) {
+    return;
+  }
+
+  // Folded stacks list the outermost frame first; each frame is the
+  // function, the leaf line is appended as an extra frame
+  m_stackBuffer.clear();
+  for (int i = depth - 1; i >= 0; --i) {
+    const lua_Debug &frame = frames[i];
+    if (!m_stackBuffer.empty()) {
+      m_stackBuffer += ';';
+    }
+
+    if (std::strcmp(frame.what, "C") == 0) {
+      m_stackBuffer += frame.name != nullptr ? frame.name : "[C]";
+      continue;
+    }
+
+    m_stackBuffer += frame.name != nullptr
+                         ? frame.name
+                         : (std::strcmp(frame.what, "main") == 0 ? "[main]"
+                                                                 : "?");
+    m_stackBuffer += " (";
+    m_stackBuffer += frame.short_src;
+    m_stackBuffer += ':';
+    m_stackBuffer += std::to_string(frame.linedefined);
+    m_stackBuffer += ')';
+  }
+
+  if (frames[0].currentline > 0) {
+    m_stackBuffer += ';';
+    m_stackBuffer += frames[0].short_src;
+    m_stackBuffer += ':';
+    m_stackBuffer += std::to_string(frames[0].currentline);
+  }
+
+  m_samples[m_stackBuffer]++;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <lua/LuaHooks.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Latency distribution with power-of-two nanosecond buckets
+class LatencyHistogram {
+public:
+  void record(uint64_t nanoseconds);
+  void reset();
+
+  uint64_t count() const;
+  uint64_t total() const;
+  uint64_t max() const;
+
+  // Upper bound of the bucket holding the given fraction (0..1) of samples
+  uint64_t percentile(double fraction) const;
+
+private:
+  std::array<uint64_t, 65> m_buckets{};
+  uint64_t m_count = 0;
+  uint64_t m_total = 0;
+  uint64_t m_max = 0;
+};
+
+// Per-callback latency accounting and a sampling profiler for Lua code.
+//
+// Timing only reads the clock while enabled. The sampler records the Lua
+// call stack every N VM instructions through the count hook and is not
+// registered with it at all while stopped.
+class LuaProfiler : public LuaHooks::Listener {
+public:
+  enum class Callback {
+    ClientConnected,
+    ClientDisconnected,
+    MessageReceived,
+    Count
+  };
+
+  explicit LuaProfiler(LuaHooks &hooks);
+  ~LuaProfiler() override;
+
+  static const char *callbackName(Callback callback);
+
+  // Callback timing; startTiming returns 0 while disabled
+  void setTimingEnabled(bool enabled);
+  bool isTimingEnabled() const;
+  uint64_t startTiming() const;
+  void stopTiming(Callback callback, uint64_t start);
+  const LatencyHistogram &getHistogram(Callback callback) const;
+  void resetTiming();
+
+  // Sampling profiler
+  void startSampling(int instructionPeriod);
+  void stopSampling();
+  bool isSampling() const;
+  void resetSamples();
+
+  // Write samples as folded stacks ("a;b;c count"), e.g. for flamegraph.pl
+  bool dumpFoldedStacks(const std::string &filename) const;
+
+  void onInstructions(lua_State *state, int instructions) override;
+
+private:
+  void sample(lua_State *state);
+
+  LuaHooks &m_hooks;
+  bool m_timingEnabled;
+  std::array<LatencyHistogram, static_cast<std::size_t>(Callback::Count)>
+      m_histograms;
+
+  bool m_sampling;
+  std::unordered_map<std::string, uint64_t> m_samples;
+  std::string m_stackBuffer;
+};
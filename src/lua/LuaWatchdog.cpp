@@ -0,0 +1,79 @@
+#include "LuaWatchdog.h"
+
+#include <can/CanMessage.h>
+
+#include <algorithm>
+
+LuaWatchdog::LuaWatchdog(LuaHooks &hooks)
+    : m_hooks(hooks), m_depth(0), m_instructions(0), m_deadline(0),
+      m_tripped(false), m_abortCount(0) {}
+
+LuaWatchdog::~LuaWatchdog() {
+  m_hooks.setListener(LuaHooks::Slot::Watchdog, nullptr, 0);
+}
+
+void LuaWatchdog::setBudget(const Budget &budget) {
+  m_budget = budget;
+
+  if (m_budget.instructions == 0 && m_budget.nanoseconds == 0) {
+    m_hooks.setListener(LuaHooks::Slot::Watchdog, nullptr, 0);
+    return;
+  }
+
+  // Check at least as often as the instruction budget allows
+  int period = CheckInterval;
+  if (m_budget.instructions != 0) {
+    period = static_cast<int>(
+        std::min<uint64_t>(m_budget.instructions, CheckInterval));
+  }
+  m_hooks.setListener(LuaHooks::Slot::Watchdog, this, period);
+}
+
+const LuaWatchdog::Budget &LuaWatchdog::getBudget() const { return m_budget; }
+
+void LuaWatchdog::arm() {
+  if (m_depth++ > 0) {
+    return;
+  }
+
+  m_instructions = 0;
+  m_tripped = false;
+  m_deadline = m_budget.nanoseconds != 0
+                   ? CanMessage::currentTimestamp() + m_budget.nanoseconds
+                   : 0;
+}
+
+void LuaWatchdog::disarm() {
+  if (m_depth > 0) {
+    m_depth--;
+  }
+}
+
+bool LuaWatchdog::tripped() const { return m_tripped; }
+
+uint64_t LuaWatchdog::getAbortCount() const { return m_abortCount; }
+
+void LuaWatchdog::onInstructions(lua_State *state, int instructions) {
+  if (m_depth == 0) {
+    return;
+  }
+
+  m_instructions += static_cast<uint64_t>(instructions);
+
+  if (!m_tripped) {
+    bool overInstructions = m_budget.instructions != 0 &&
+                            m_instructions > m_budget.instructions;
+    bool overTime = m_deadline != 0 &&
+                    CanMessage::currentTimestamp() > m_deadline;
+    if (!overInstructions && !overTime) {
+      return;
+    }
+
+    m_tripped = true;
+    m_abortCount++;
+  }
+
+  // Unwinds to the pcall around the callback, skipping destructors, so no
+  // objects with destructors may be alive here or in the hook dispatch
+  luaL_error(state, "callback exceeded its execution budget");
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <lua/LuaHooks.h>
+
+#include <cstdint>
+
+// Aborts Lua callbacks that run past an instruction or wall-time budget.
+//
+// The budget is checked from the count hook while a callback is armed. Once
+// a callback has exceeded it, every further check raises an error again, so
+// a pcall inside the script cannot swallow the abort.
+class LuaWatchdog : public LuaHooks::Listener {
+public:
+  // Instructions between budget checks
+  static constexpr int CheckInterval = 1000;
+
+  // 0 means unlimited
+  struct Budget {
+    uint64_t instructions = 0;
+    uint64_t nanoseconds = 0;
+  };
+
+  explicit LuaWatchdog(LuaHooks &hooks);
+  ~LuaWatchdog() override;
+
+  void setBudget(const Budget &budget);
+  const Budget &getBudget() const;
+
+  // Bracket a callback; nested calls share the outermost budget
+  void arm();
+  void disarm();
+
+  // Whether the current or last armed callback exceeded its budget
+  bool tripped() const;
+
+  // Callbacks aborted so far
+  uint64_t getAbortCount() const;
+
+  void onInstructions(lua_State *state, int instructions) override;
+
+private:
+  LuaHooks &m_hooks;
+  Budget m_budget;
+  int m_depth;
+  uint64_t m_instructions;
+  uint64_t m_deadline;
+  bool m_tripped;
+  uint64_t m_abortCount;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Memory layout of the shared-memory tap, shared by the server (single
+// writer) and any number of readers mapping the same segment.
+//
+// Slots are written seqlock style: the slot sequence is cleared, the payload
+// written, then the sequence set to (record number + 1). Readers check the
+// sequence before and after reading a slot to detect records overwritten
+// while they were looking at them. The writer never waits for readers.
+namespace ShmRing {
+
+constexpr uint32_t Magic = 0x43414E54; // "CANT"
+constexpr uint32_t Version = 1;
+constexpr std::size_t MaxDataLength = 64;
+constexpr std::size_t SessionIdLength = 16;
+// Slot counts are powers of two up to this many
+constexpr std::size_t MaxSlotCount = std::size_t{1} << 24;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Shared-memory sequences require lock-free 64-bit atomics");
+
+enum class Direction : uint8_t { Inbound = 0, Outbound = 1 };
+
+// Slot flags, bits 0-2 match the wire format
+constexpr uint8_t FlagExtended = 0x01;
+constexpr uint8_t FlagRtr = 0x02;
+constexpr uint8_t FlagTruncated = 0x80; // payload longer than MaxDataLength
+
+struct alignas(64) Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slotCount; // power of two
+  uint32_t slotSize;
+
+  // Number of records published so far
+  alignas(64) std::atomic<uint64_t> writeSequence;
+};
+
+struct alignas(64) Slot {
+  std::atomic<uint64_t> sequence; // record number + 1, 0 while writing
+  uint64_t timestamp;             // CanMessage timestamp, monotonic ns
+  uint32_t canId;
+  uint8_t flags;
+  uint8_t direction;
+  uint8_t length;
+  uint8_t reserved;
+  char sessionId[SessionIdLength]; // NUL-padded
+  uint8_t data[MaxDataLength];
+};
+
+inline std::size_t segmentSize(std::size_t slotCount) {
+  return sizeof(Header) + slotCount * sizeof(Slot);
+}
+
+inline Slot *slots(Header *header) {
+  return reinterpret_cast<Slot *>(reinterpret_cast<char *>(header) +
+                                  sizeof(Header));
+}
+
+inline const Slot *slots(const Header *header) {
+  return reinterpret_cast<const Slot *>(
+      reinterpret_cast<const char *>(header) + sizeof(Header));
+}
+
+} // namespace ShmRing
@@ -0,0 +1,115 @@
+#include "ShmRingReader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ShmRingReader::~ShmRingReader() { close(); }
+
+bool ShmRingReader::open(const std::string &name) {
+  close();
+
+  const std::string path = name.empty() || name[0] != '/' ? "/" + name : name;
+  int fd = ::shm_open(path.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info {};
+  if (::fstat(fd, &info) != 0 ||
+      static_cast<std::size_t>(info.st_size) < sizeof(ShmRing::Header)) {
+    ::close(fd);
+    return false;
+  }
+
+  m_size = static_cast<std::size_t>(info.st_size);
+  void *memory = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    return false;
+  }
+
+  const auto *header = static_cast<const ShmRing::Header *>(memory);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (header->magic != ShmRing::Magic || header->version != ShmRing::Version ||
+      header->slotSize != sizeof(ShmRing::Slot) || header->slotCount == 0 ||
+      header->slotCount > ShmRing::MaxSlotCount ||
+      (header->slotCount & (header->slotCount - 1)) != 0 ||
+      ShmRing::segmentSize(header->slotCount) > m_size) {
+    ::munmap(memory, m_size);
+    return false;
+  }
+
+  m_header = header;
+  m_slots = ShmRing::slots(header);
+  m_mask = header->slotCount - 1;
+  m_next = header->writeSequence.load(std::memory_order_acquire);
+  m_lost = 0;
+  m_current = nullptr;
+  return true;
+}
+
+void ShmRingReader::close() {
+  if (m_header == nullptr) {
+    return;
+  }
+
+  ::munmap(const_cast<ShmRing::Header *>(m_header), m_size);
+  m_header = nullptr;
+  m_slots = nullptr;
+  m_current = nullptr;
+}
+
+bool ShmRingReader::isOpen() const { return m_header != nullptr; }
+
+const ShmRing::Slot *ShmRingReader::peek() {
+  if (m_header == nullptr) {
+    return nullptr;
+  }
+
+  const uint64_t written =
+      m_header->writeSequence.load(std::memory_order_acquire);
+  if (written <= m_next) {
+    return nullptr;
+  }
+
+  // Lapped by the writer, skip to the oldest record still in the ring
+  const uint64_t capacity = m_mask + 1;
+  if (written - m_next > capacity) {
+    m_lost += written - capacity - m_next;
+    m_next = written - capacity;
+  }
+
+  const ShmRing::Slot &slot = m_slots[m_next & m_mask];
+  if (slot.sequence.load(std::memory_order_acquire) != m_next + 1) {
+    // Being rewritten for a newer record
+    m_lost++;
+    m_next++;
+    return nullptr;
+  }
+
+  m_current = &slot;
+  return m_current;
+}
+
+bool ShmRingReader::release() {
+  if (m_current == nullptr) {
+    return false;
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const bool intact =
+      m_current->sequence.load(std::memory_order_relaxed) == m_next + 1;
+  if (!intact) {
+    m_lost++;
+  }
+
+  m_current = nullptr;
+  m_next++;
+  return intact;
+}
+
+uint64_t ShmRingReader::position() const { return m_next; }
+
+uint64_t ShmRingReader::lostRecords() const { return m_lost; }
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <shm/ShmRingLayout.h>
+
+#include <cstdint>
+#include <string>
+
+// Reads the shared-memory tap published by the server.
+//
+// Records are accessed in place: peek() returns the next slot and release()
+// tells whether it stayed intact while it was being read. A reader that
+// falls behind by more than the ring size skips ahead and counts the lost
+// records; it never slows the server down.
+class ShmRingReader {
+public:
+  ShmRingReader() = default;
+  ~ShmRingReader();
+
+  ShmRingReader(const ShmRingReader &) = delete;
+  ShmRingReader &operator=(const ShmRingReader &) = delete;
+
+  // Map an existing segment; reading starts at the newest record
+  bool open(const std::string &name);
+  void close();
+  bool isOpen() const;
+
+  // Next unread record, nullptr if there is none yet
+  const ShmRing::Slot *peek();
+
+  // Finish reading the record returned by peek(); false if it was
+  // overwritten in the meantime and must be discarded
+  bool release();
+
+  // Record number of the next record to be read
+  uint64_t position() const;
+  uint64_t lostRecords() const;
+
+private:
+  const ShmRing::Header *m_header = nullptr;
+  const ShmRing::Slot *m_slots = nullptr;
+  const ShmRing::Slot *m_current = nullptr;
+  std::size_t m_size = 0;
+  uint64_t m_mask = 0;
+  uint64_t m_next = 0;
+  uint64_t m_lost = 0;
+};
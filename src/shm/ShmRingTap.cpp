@@ -0,0 +1,141 @@
+#include "ShmRingTap.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define SHM_RING_TAP_SUPPORTED 1
+#endif
+
+ShmRingTap::~ShmRingTap() { close(); }
+
+bool ShmRingTap::open(const std::string &name, std::size_t slotCount) {
+  close();
+
+  if (slotCount == 0 || slotCount > ShmRing::MaxSlotCount) {
+    spdlog::error("Shared memory tap slot count must be between 1 and {}",
+                  ShmRing::MaxSlotCount);
+    return false;
+  }
+
+#ifdef SHM_RING_TAP_SUPPORTED
+  std::size_t count = 1;
+  while (count < std::max<std::size_t>(slotCount, 2)) {
+    count <<= 1;
+  }
+
+  // POSIX shared memory names start with a slash
+  m_name = name.empty() || name[0] != '/' ? "/" + name : name;
+  m_size = ShmRing::segmentSize(count);
+
+  int fd = ::shm_open(m_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0) {
+    spdlog::error("shm_open({}) failed: {}", m_name, std::strerror(errno));
+    return false;
+  }
+
+  if (::ftruncate(fd, static_cast<off_t>(m_size)) != 0) {
+    spdlog::error("Sizing shared memory {} failed: {}", m_name,
+                  std::strerror(errno));
+    ::close(fd);
+    ::shm_unlink(m_name.c_str());
+    return false;
+  }
+
+  void *memory =
+      ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    spdlog::error("Mapping shared memory {} failed: {}", m_name,
+                  std::strerror(errno));
+    ::shm_unlink(m_name.c_str());
+    return false;
+  }
+
+  // The segment is zero-filled by ftruncate, so all slots start empty
+  m_header = new (memory) ShmRing::Header;
+  m_header->slotCount = static_cast<uint32_t>(count);
+  m_header->slotSize = static_cast<uint32_t>(sizeof(ShmRing::Slot));
+  m_header->version = ShmRing::Version;
+  m_header->writeSequence.store(0, std::memory_order_relaxed);
+  m_slots = ShmRing::slots(m_header);
+  m_mask = count - 1;
+  m_sequence = 0;
+
+  // Readers check the magic last, once the rest of the header is valid
+  std::atomic_thread_fence(std::memory_order_release);
+  m_header->magic = ShmRing::Magic;
+
+  spdlog::info("Shared memory tap {} with {} slots", m_name, count);
+  return true;
+#else
+  (void)name;
+  (void)slotCount;
+  spdlog::error("Shared memory tap is not supported on this platform");
+  return false;
+#endif
+}
+
+void ShmRingTap::close() {
+#ifdef SHM_RING_TAP_SUPPORTED
+  if (m_header == nullptr) {
+    return;
+  }
+
+  ::munmap(m_header, m_size);
+  ::shm_unlink(m_name.c_str());
+#endif
+
+  m_header = nullptr;
+  m_slots = nullptr;
+  m_size = 0;
+}
+
+bool ShmRingTap::isOpen() const { return m_header != nullptr; }
+
+void ShmRingTap::publish(const std::string &sessionId,
+                         const CanMessage &message,
+                         ShmRing::Direction direction) {
+  if (m_header == nullptr) {
+    return;
+  }
+
+  ShmRing::Slot &slot = m_slots[m_sequence & m_mask];
+
+  // Mark the slot as being written before touching the payload
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  const auto &data = message.getData();
+  const std::size_t length = std::min(data.size(), ShmRing::MaxDataLength);
+
+  uint8_t flags = 0;
+  if (message.isExtended())
+    flags |= ShmRing::FlagExtended;
+  if (message.isRTR())
+    flags |= ShmRing::FlagRtr;
+  if (length < data.size())
+    flags |= ShmRing::FlagTruncated;
+
+  slot.timestamp = message.getTimestamp();
+  slot.canId = message.getID();
+  slot.flags = flags;
+  slot.direction = static_cast<uint8_t>(direction);
+  slot.length = static_cast<uint8_t>(length);
+
+  std::memset(slot.sessionId, 0, sizeof(slot.sessionId));
+  std::memcpy(slot.sessionId, sessionId.data(),
+              std::min(sessionId.size(), sizeof(slot.sessionId) - 1));
+  std::memcpy(slot.data, data.data(), length);
+
+  m_sequence++;
+  slot.sequence.store(m_sequence, std::memory_order_release);
+  m_header->writeSequence.store(m_sequence, std::memory_order_release);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <can/CanMessage.h>
+#include <shm/ShmRingLayout.h>
+
+#include <cstdint>
+#include <string>
+
+// Publishes CAN traffic into a POSIX shared-memory ring so co-located
+// processes can mirror it without a TCP connection. Only available on POSIX
+// systems; open() fails elsewhere.
+class ShmRingTap {
+public:
+  ShmRingTap() = default;
+  ~ShmRingTap();
+
+  ShmRingTap(const ShmRingTap &) = delete;
+  ShmRingTap &operator=(const ShmRingTap &) = delete;
+
+  // Create (or replace) the segment; slotCount is rounded up to a power of 2
+  bool open(const std::string &name, std::size_t slotCount);
+  void close();
+  bool isOpen() const;
+
+  void publish(const std::string &sessionId, const CanMessage &message,
+               ShmRing::Direction direction);
+
+private:
+  std::string m_name;
+  ShmRing::Header *m_header = nullptr;
+  ShmRing::Slot *m_slots = nullptr;
+  std::size_t m_size = 0;
+  uint64_t m_mask = 0;
+  uint64_t m_sequence = 0;
+};
@@ -0,0 +1,136 @@
+#include "AutoResponder.h"
+
+#include <algorithm>
+
+AutoResponder::RuleId AutoResponder::addRule(const AutoResponseRule &rule) {
+  RuleId id = m_nextId++;
+  m_rules.push_back({id, rule, 0});
+  rebuildIndex();
+  return id;
+}
+
+bool AutoResponder::removeRule(RuleId ruleId) {
+  auto it = std::find_if(m_rules.begin(), m_rules.end(),
+                         [ruleId](const Entry &entry) {
+                           return entry.id == ruleId;
+                         });
+  if (it == m_rules.end()) {
+    return false;
+  }
+
+  m_rules.erase(it);
+  rebuildIndex();
+  return true;
+}
+
+void AutoResponder::clear() {
+  m_rules.clear();
+  m_exact.clear();
+  m_masked.clear();
+}
+
+bool AutoResponder::empty() const { return m_rules.empty(); }
+
+const AutoResponseRule *AutoResponder::match(const CanMessage &message) {
+  if (m_rules.empty()) {
+    return nullptr;
+  }
+
+  // Indexes hold positions in m_rules in ascending order, so the first
+  // match of each list is the oldest rule of that list
+  std::size_t best = m_rules.size();
+
+  auto exact = m_exact.find(message.getID() & CanFilter::ExactMask);
+  if (exact != m_exact.end()) {
+    for (auto index : exact->second) {
+      if (payloadMatches(m_rules[index].rule, message)) {
+        best = index;
+        break;
+      }
+    }
+  }
+
+  for (auto index : m_masked) {
+    if (index >= best) {
+      break;
+    }
+    const auto &rule = m_rules[index].rule;
+    if (rule.match.matches(message.getID()) && payloadMatches(rule, message)) {
+      best = index;
+      break;
+    }
+  }
+
+  if (best == m_rules.size()) {
+    return nullptr;
+  }
+
+  m_rules[best].hits++;
+  return &m_rules[best].rule;
+}
+
+void AutoResponder::buildReply(const AutoResponseRule &rule,
+                               const CanMessage &request, CanMessage &reply) {
+  uint32_t id = rule.replyId.value_or(static_cast<uint32_t>(
+      static_cast<int64_t>(request.getID()) + rule.idOffset));
+
+  reply.setID(id);
+  reply.setExtended(request.isExtended());
+  reply.setRTR(false);
+  reply.setControl(false);
+  reply.setTimestamp(request.getTimestamp());
+
+  if (rule.patches.empty()) {
+    reply.setData(rule.data ? *rule.data : request.getData());
+    return;
+  }
+
+  m_patchBuffer = rule.data ? *rule.data : request.getData();
+  for (const auto &patch : rule.patches) {
+    if (patch.index >= CanMessage::MaxDataLength) {
+      continue;
+    }
+    if (patch.index >= m_patchBuffer.size()) {
+      m_patchBuffer.resize(patch.index + 1, 0);
+    }
+    m_patchBuffer[patch.index] = patch.value;
+  }
+  reply.setData(m_patchBuffer);
+}
+
+std::vector<std::pair<AutoResponder::RuleId, uint64_t>>
+AutoResponder::getHitCounts() const {
+  std::vector<std::pair<RuleId, uint64_t>> counts;
+  counts.reserve(m_rules.size());
+
+  for (const auto &entry : m_rules) {
+    counts.emplace_back(entry.id, entry.hits);
+  }
+
+  return counts;
+}
+
+bool AutoResponder::payloadMatches(const AutoResponseRule &rule,
+                                   const CanMessage &message) {
+  const auto &data = message.getData();
+
+  return std::all_of(rule.payload.begin(), rule.payload.end(),
+                     [&data](const AutoResponseRule::BytePattern &pattern) {
+                       return pattern.index < data.size() &&
+                              data[pattern.index] == pattern.value;
+                     });
+}
+
+void AutoResponder::rebuildIndex() {
+  m_exact.clear();
+  m_masked.clear();
+
+  for (std::size_t i = 0; i < m_rules.size(); ++i) {
+    const auto &filter = m_rules[i].rule.match;
+    if (filter.isExact()) {
+      m_exact[filter.id & CanFilter::ExactMask].push_back(i);
+    } else {
+      m_masked.push_back(i);
+    }
+  }
+}
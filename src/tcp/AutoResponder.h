@@ -0,0 +1,50 @@
+#pragma once
+
+#include <can/CanMessage.h>
+#include <tcp/AutoResponseRule.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Rule table checked for every inbound frame before Lua dispatch.
+//
+// Exact-ID rules are found through a hash index, mask rules are tested in
+// order. If several rules match, the one added first wins.
+class AutoResponder {
+public:
+  using RuleId = AutoResponseRule::Id;
+
+  RuleId addRule(const AutoResponseRule &rule);
+  bool removeRule(RuleId ruleId);
+  void clear();
+  bool empty() const;
+
+  // Rule answering the message, nullptr if none matches
+  const AutoResponseRule *match(const CanMessage &message);
+
+  // Fill reply from the rule template; reuses reply's payload storage
+  void buildReply(const AutoResponseRule &rule, const CanMessage &request,
+                  CanMessage &reply);
+
+  // Times each rule has matched
+  std::vector<std::pair<RuleId, uint64_t>> getHitCounts() const;
+
+private:
+  struct Entry {
+    RuleId id;
+    AutoResponseRule rule;
+    uint64_t hits;
+  };
+
+  static bool payloadMatches(const AutoResponseRule &rule,
+                             const CanMessage &message);
+  void rebuildIndex();
+
+  std::vector<Entry> m_rules;
+  std::unordered_map<uint32_t, std::vector<std::size_t>> m_exact;
+  std::vector<std::size_t> m_masked;
+  std::vector<uint8_t> m_patchBuffer;
+  RuleId m_nextId = 1;
+};
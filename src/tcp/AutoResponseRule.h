@@ -0,0 +1,34 @@
+#pragma once
+
+#include <can/CanFilter.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Request/response rule answered natively, without a Lua round trip
+struct AutoResponseRule {
+  using Id = uint32_t;
+
+  enum class Target { Sender, Broadcast };
+
+  struct BytePattern {
+    std::size_t index = 0;
+    uint8_t value = 0;
+  };
+
+  // Request matching
+  CanFilter match;
+  std::vector<BytePattern> payload;
+
+  // Reply template: the request ID plus idOffset, or a fixed replyId
+  int64_t idOffset = 0;
+  std::optional<uint32_t> replyId;
+  // Fixed payload; the request payload is copied if not set
+  std::optional<std::vector<uint8_t>> data;
+  // Bytes overwritten after copying (payload grows if needed, up to
+  // CanMessage::MaxDataLength)
+  std::vector<BytePattern> patches;
+  Target target = Target::Sender;
+};
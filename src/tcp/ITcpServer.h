@@ -1,11 +1,15 @@
 #pragma once
 
+#include <can/CanFilter.h>
 #include <can/CanMessage.h>
+#include <tcp/AutoResponseRule.h>
 
 #include <asio.hpp>
 
 #include <functional>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 class ITcpServer {
@@ -17,6 +21,33 @@ public:
   using ConnectCallback = std::function<void(const SessionId &)>;
   using DisconnectCallback = std::function<void(const SessionId &)>;
 
+  // What happens to frames arriving faster than a client's rate limit
+  enum class ThrottleMode {
+    Drop, // discard the frame
+    Pause // stop reading until tokens refill (TCP backpressure)
+  };
+
+  // Inbound limits per client; a rate of 0 means unlimited
+  struct RateLimit {
+    double framesPerSecond = 0.0;
+    double bytesPerSecond = 0.0;
+    ThrottleMode mode = ThrottleMode::Drop;
+  };
+
+  struct RateLimitStats {
+    uint64_t droppedFrames = 0;
+    uint64_t droppedBytes = 0;
+    uint64_t delayedFrames = 0; // frames held back in pause mode
+    uint64_t pauses = 0;
+  };
+
+  struct SessionPoolStats {
+    std::size_t capacity = 0; // max concurrent connections
+    std::size_t inUse = 0;
+    std::size_t peak = 0;
+    uint64_t rejected = 0; // connections refused because the pool was full
+  };
+
   virtual ~ITcpServer() = default;
 
   virtual void start() = 0;
@@ -25,7 +56,48 @@ public:
   virtual bool sendMessage(const std::string &clientId,
                            const CanMessage &message) = 0;
   virtual void broadcastMessage(const CanMessage &message) = 0;
+  // Batches go out as a single write per client
+  virtual bool sendMessages(const std::string &clientId,
+                            const CanMessage *messages, std::size_t count) = 0;
+  virtual void broadcastMessages(const CanMessage *messages,
+                                 std::size_t count) = 0;
   virtual std::vector<std::string> getConnectedClients() const = 0;
+  virtual SessionPoolStats getSessionPoolStats() const = 0;
+
+  // Subscriptions limit which broadcasts reach a client
+  virtual bool setSubscriptions(const std::string &clientId,
+                                const std::vector<CanFilter> &filters) = 0;
+  virtual bool clearSubscriptions(const std::string &clientId) = 0;
+  virtual std::optional<std::vector<CanFilter>>
+  getSubscriptions(const std::string &clientId) const = 0;
+
+  // Global limit applies to every client without its own limit
+  virtual void setRateLimit(const RateLimit &limit) = 0;
+  virtual bool setClientRateLimit(const std::string &clientId,
+                                  std::optional<RateLimit> limit) = 0;
+  virtual RateLimitStats getRateLimitStats() const = 0;
+  virtual std::optional<RateLimitStats>
+  getClientRateLimitStats(const std::string &clientId) const = 0;
+
+  // Native request/response rules, checked before the message callback
+  virtual AutoResponseRule::Id
+  addAutoResponse(const AutoResponseRule &rule) = 0;
+  virtual bool removeAutoResponse(AutoResponseRule::Id ruleId) = 0;
+  virtual void clearAutoResponses() = 0;
+  virtual std::vector<std::pair<AutoResponseRule::Id, uint64_t>>
+  getAutoResponseHits() const = 0;
+
+  // Latest frame seen per CAN ID, inbound or broadcast
+  virtual std::optional<CanMessage> getLastMessage(uint32_t id,
+                                                   bool extended) const = 0;
+  virtual void setSnapshotOnConnect(bool enabled) = 0;
+
+  // Mirror all traffic into a shared-memory ring for local readers
+  virtual bool enableTap(const std::string &name, std::size_t slotCount) = 0;
+  virtual void disableTap() = 0;
+
+  // Append receive timestamps to outbound frames
+  virtual void setWireTimestamps(bool enabled) = 0;
 
   virtual void setMessageCallback(MessageCallback callback) = 0;
   virtual void setConnectCallback(ConnectCallback callback) = 0;
@@ -0,0 +1,252 @@
+#include "SubscriptionIndex.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+bool filterLess(const CanFilter &lhs, const CanFilter &rhs) {
+  return std::tie(lhs.id, lhs.mask) < std::tie(rhs.id, rhs.mask);
+}
+
+bool filterEqual(const CanFilter &lhs, const CanFilter &rhs) {
+  return lhs.id == rhs.id && lhs.mask == rhs.mask;
+}
+
+std::vector<CanFilter> normalize(std::vector<CanFilter> filters) {
+  for (auto &filter : filters) {
+    if (filter.isExact()) {
+      filter.id &= CanFilter::ExactMask;
+      filter.mask = CanFilter::ExactMask;
+    }
+  }
+
+  std::sort(filters.begin(), filters.end(), filterLess);
+  filters.erase(std::unique(filters.begin(), filters.end(), filterEqual),
+                filters.end());
+  return filters;
+}
+
+} // namespace
+
+void SubscriptionIndex::reserve(std::size_t sessions) {
+  m_entries.reserve(sessions);
+  m_unfiltered.reserve(sessions);
+  m_freeEntries.reserve(sessions);
+  m_freeUnfiltered.reserve(sessions);
+}
+
+void SubscriptionIndex::addSession(const SessionId &id) {
+  if (m_entries.count(id) != 0) {
+    return;
+  }
+
+  EntryMap::iterator it;
+  if (m_freeEntries.empty()) {
+    it = m_entries.try_emplace(id).first;
+  } else {
+    auto node = std::move(m_freeEntries.back());
+    m_freeEntries.pop_back();
+    node.key() = id;
+    it = m_entries.insert(std::move(node)).position;
+  }
+
+  if (m_freeUnfiltered.empty()) {
+    m_unfiltered.insert(&it->first);
+  } else {
+    auto node = std::move(m_freeUnfiltered.back());
+    m_freeUnfiltered.pop_back();
+    node.value() = &it->first;
+    m_unfiltered.insert(std::move(node));
+  }
+}
+
+void SubscriptionIndex::removeSession(const SessionId &id) {
+  auto it = m_entries.find(id);
+  if (it == m_entries.end()) {
+    return;
+  }
+
+  unindexFilters(&it->first, it->second);
+
+  auto unfiltered = m_unfiltered.extract(&it->first);
+  if (!unfiltered.empty()) {
+    m_freeUnfiltered.push_back(std::move(unfiltered));
+  }
+
+  auto node = m_entries.extract(it);
+  node.mapped().filtered = false;
+  node.mapped().filters.clear();
+  m_freeEntries.push_back(std::move(node));
+}
+
+void SubscriptionIndex::clear() {
+  m_entries.clear();
+  m_unfiltered.clear();
+  m_exact.clear();
+  m_masked.clear();
+}
+
+bool SubscriptionIndex::setFilters(const SessionId &id,
+                                   const std::vector<CanFilter> &filters) {
+  auto it = m_entries.find(id);
+  if (it == m_entries.end()) {
+    return false;
+  }
+
+  const SessionId *key = &it->first;
+  Entry &entry = it->second;
+
+  unindexFilters(key, entry);
+  m_unfiltered.erase(key);
+
+  entry.filtered = true;
+  entry.filters = normalize(filters);
+  indexFilters(key, entry);
+
+  return true;
+}
+
+bool SubscriptionIndex::addFilters(const SessionId &id,
+                                   const std::vector<CanFilter> &filters) {
+  auto it = m_entries.find(id);
+  if (it == m_entries.end()) {
+    return false;
+  }
+
+  std::vector<CanFilter> merged = it->second.filters;
+  merged.insert(merged.end(), filters.begin(), filters.end());
+  return setFilters(id, merged);
+}
+
+bool SubscriptionIndex::removeFilters(const SessionId &id,
+                                      const std::vector<CanFilter> &filters) {
+  auto it = m_entries.find(id);
+  if (it == m_entries.end()) {
+    return false;
+  }
+
+  // Nothing to take away from a session that receives everything
+  if (!it->second.filtered) {
+    return true;
+  }
+
+  auto removed = normalize(filters);
+  std::vector<CanFilter> remaining;
+  for (const auto &filter : it->second.filters) {
+    if (!std::binary_search(removed.begin(), removed.end(), filter,
+                            filterLess)) {
+      remaining.push_back(filter);
+    }
+  }
+
+  return setFilters(id, remaining);
+}
+
+bool SubscriptionIndex::clearFilters(const SessionId &id) {
+  auto it = m_entries.find(id);
+  if (it == m_entries.end()) {
+    return false;
+  }
+
+  unindexFilters(&it->first, it->second);
+  it->second = Entry{};
+  m_unfiltered.insert(&it->first);
+
+  return true;
+}
+
+std::optional<std::vector<CanFilter>>
+SubscriptionIndex::getFilters(const SessionId &id) const {
+  auto it = m_entries.find(id);
+  if (it == m_entries.end() || !it->second.filtered) {
+    return std::nullopt;
+  }
+
+  return it->second.filters;
+}
+
+bool SubscriptionIndex::matches(const SessionId &id, uint32_t canId) const {
+  auto it = m_entries.find(id);
+  if (it == m_entries.end()) {
+    return false;
+  }
+
+  const Entry &entry = it->second;
+  if (!entry.filtered) {
+    return true;
+  }
+
+  return std::any_of(
+      entry.filters.begin(), entry.filters.end(),
+      [canId](const CanFilter &filter) { return filter.matches(canId); });
+}
+
+void SubscriptionIndex::collect(uint32_t canId,
+                                std::vector<const SessionId *> &targets) const {
+  targets.clear();
+  targets.insert(targets.end(), m_unfiltered.begin(), m_unfiltered.end());
+
+  auto exact = m_exact.find(canId & CanFilter::ExactMask);
+  if (exact != m_exact.end()) {
+    targets.insert(targets.end(), exact->second.begin(), exact->second.end());
+  }
+
+  if (m_masked.empty()) {
+    return;
+  }
+
+  // Unfiltered sessions never appear in the filter indexes
+  auto filteredBegin = static_cast<std::ptrdiff_t>(m_unfiltered.size());
+  bool maskedMatch = false;
+  for (const auto &[id, filter] : m_masked) {
+    if (filter.matches(canId)) {
+      targets.push_back(id);
+      maskedMatch = true;
+    }
+  }
+
+  // A session may match through several filters; report it only once
+  if (maskedMatch) {
+    auto begin = targets.begin() + filteredBegin;
+    std::sort(begin, targets.end());
+    targets.erase(std::unique(begin, targets.end()), targets.end());
+  }
+}
+
+void SubscriptionIndex::indexFilters(const SessionId *id, const Entry &entry) {
+  for (const auto &filter : entry.filters) {
+    if (filter.isExact()) {
+      m_exact[filter.id].push_back(id);
+    } else {
+      m_masked.emplace_back(id, filter);
+    }
+  }
+}
+
+void SubscriptionIndex::unindexFilters(const SessionId *id,
+                                       const Entry &entry) {
+  for (const auto &filter : entry.filters) {
+    if (!filter.isExact()) {
+      continue;
+    }
+
+    auto it = m_exact.find(filter.id);
+    if (it == m_exact.end()) {
+      continue;
+    }
+
+    auto &sessions = it->second;
+    sessions.erase(std::remove(sessions.begin(), sessions.end(), id),
+                   sessions.end());
+    if (sessions.empty()) {
+      m_exact.erase(it);
+    }
+  }
+
+  m_masked.erase(std::remove_if(m_masked.begin(), m_masked.end(),
+                                [id](const auto &masked) {
+                                  return masked.first == id;
+                                }),
+                 m_masked.end());
+}
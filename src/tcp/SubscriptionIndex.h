@@ -0,0 +1,67 @@
+#pragma once
+
+#include <can/CanFilter.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Maps CAN IDs to the sessions interested in them.
+//
+// Sessions start out unfiltered and receive every frame. Once a session has
+// subscribed, exact-ID filters are resolved through an inverted index and
+// only mask filters need to be tested one by one.
+class SubscriptionIndex {
+public:
+  using SessionId = std::string;
+
+  // Sessions removed are kept for reuse, so add/remove up to this many
+  // sessions does not allocate
+  void reserve(std::size_t sessions);
+
+  void addSession(const SessionId &id);
+  void removeSession(const SessionId &id);
+  void clear();
+
+  // Replace the filters of a session; the session becomes filtered
+  bool setFilters(const SessionId &id, const std::vector<CanFilter> &filters);
+  bool addFilters(const SessionId &id, const std::vector<CanFilter> &filters);
+  bool removeFilters(const SessionId &id,
+                     const std::vector<CanFilter> &filters);
+
+  // Go back to receiving every frame
+  bool clearFilters(const SessionId &id);
+
+  // std::nullopt means the session receives every frame
+  std::optional<std::vector<CanFilter>>
+  getFilters(const SessionId &id) const;
+
+  bool matches(const SessionId &id, uint32_t canId) const;
+
+  // Collect the sessions interested in canId into targets (cleared first)
+  void collect(uint32_t canId, std::vector<const SessionId *> &targets) const;
+
+private:
+  struct Entry {
+    bool filtered = false;
+    std::vector<CanFilter> filters;
+  };
+
+  void indexFilters(const SessionId *id, const Entry &entry);
+  void unindexFilters(const SessionId *id, const Entry &entry);
+
+  using EntryMap = std::unordered_map<SessionId, Entry>;
+  using SessionSet = std::unordered_set<const SessionId *>;
+
+  // Keys of m_entries are node-stable, so the indexes point into them
+  EntryMap m_entries;
+  SessionSet m_unfiltered;
+  std::vector<EntryMap::node_type> m_freeEntries;
+  std::vector<SessionSet::node_type> m_freeUnfiltered;
+  std::unordered_map<uint32_t, std::vector<const SessionId *>> m_exact;
+  std::vector<std::pair<const SessionId *, CanFilter>> m_masked;
+};
@@ -5,9 +5,56 @@
 #include <asio/streambuf.hpp>
 #include <spdlog/spdlog.h>
 
-TcpServer::TcpServer(asio::io_context &ioContext, uint16_t port)
-    : m_acceptor(ioContext, tcp::endpoint(tcp::v4(), port)), m_running(false),
-      m_nextId(1) {}
+#include <algorithm>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+namespace {
+
+int64_t toNanoseconds(const timespec &time) {
+  return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+// Software receive stamps are taken on CLOCK_REALTIME; shift them onto the
+// monotonic clock used for CanMessage timestamps
+uint64_t toMonotonic(const timespec &kernelTime) {
+  timespec now{};
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  int64_t age = toNanoseconds(now) - toNanoseconds(kernelTime);
+  uint64_t monotonicNow = CanMessage::currentTimestamp();
+  if (age < 0 || static_cast<uint64_t>(age) > monotonicNow) {
+    return monotonicNow;
+  }
+
+  return monotonicNow - static_cast<uint64_t>(age);
+}
+
+} // namespace
+#endif
+
+TcpServer::TcpServer(asio::io_context &ioContext, uint16_t port,
+                     std::size_t maxConnections)
+    : m_acceptor(ioContext, tcp::endpoint(tcp::v4(), port)),
+      m_maxConnections(maxConnections), m_peakSessions(0),
+      m_rejectedConnections(0), m_snapshotOnConnect(false), m_running(false),
+      m_nextId(1), m_wireTimestamps(false) {
+  m_sessions.reserve(m_maxConnections);
+  m_freeSessions.reserve(m_maxConnections);
+  m_freeNodes.reserve(m_maxConnections);
+  m_subscriptions.reserve(m_maxConnections);
+
+  for (std::size_t i = 0; i < m_maxConnections; ++i) {
+    m_freeSessions.push_back(std::make_shared<Session>(*this));
+  }
+}
 
 TcpServer::~TcpServer() { TcpServer::stop(); }
 
@@ -27,10 +74,10 @@ void TcpServer::stop() {
   std::error_code ec;
   m_acceptor.close(ec);
 
-  for (const auto &[id, session] : m_sessions) {
-    session->stop();
+  while (!m_sessions.empty()) {
+    releaseSession(m_sessions.begin());
   }
-  m_sessions.clear();
+  m_subscriptions.clear();
 
   spdlog::info("TCP Server stopped");
 }
@@ -46,8 +93,45 @@ bool TcpServer::sendMessage(const std::string &sessionId,
 }
 
 void TcpServer::broadcastMessage(const CanMessage &message) {
-  for (const auto &[id, session] : m_sessions) {
-    session->send(message);
+  m_lastValues.update(message);
+  m_subscriptions.collect(message.getID(), m_broadcastTargets);
+
+  for (const auto *id : m_broadcastTargets) {
+    auto it = m_sessions.find(*id);
+    if (it != m_sessions.end()) {
+      it->second->send(message);
+    }
+  }
+}
+
+bool TcpServer::sendMessages(const std::string &sessionId,
+                             const CanMessage *messages, std::size_t count) {
+  auto it = m_sessions.find(sessionId);
+  if (it == m_sessions.end()) {
+    return false;
+  }
+
+  return it->second->send(messages, count);
+}
+
+void TcpServer::broadcastMessages(const CanMessage *messages,
+                                  std::size_t count) {
+  // Group the frames by target session, then send each group in one write
+  m_batchSessions.clear();
+  for (std::size_t i = 0; i < count; ++i) {
+    m_lastValues.update(messages[i]);
+    m_subscriptions.collect(messages[i].getID(), m_broadcastTargets);
+
+    for (const auto *id : m_broadcastTargets) {
+      auto it = m_sessions.find(*id);
+      if (it != m_sessions.end() && it->second->addToBatch(messages[i])) {
+        m_batchSessions.push_back(it->second.get());
+      }
+    }
+  }
+
+  for (auto *session : m_batchSessions) {
+    session->flushBatch();
   }
 }
 
@@ -62,6 +146,109 @@ std::vector<std::string> TcpServer::getConnectedClients() const {
   return clients;
 }
 
+TcpServer::SessionPoolStats TcpServer::getSessionPoolStats() const {
+  SessionPoolStats stats;
+  stats.capacity = m_maxConnections;
+  stats.inUse = m_sessions.size();
+  stats.peak = m_peakSessions;
+  stats.rejected = m_rejectedConnections;
+  return stats;
+}
+
+bool TcpServer::setSubscriptions(const SessionId &sessionId,
+                                 const std::vector<CanFilter> &filters) {
+  return m_subscriptions.setFilters(sessionId, filters);
+}
+
+bool TcpServer::clearSubscriptions(const SessionId &sessionId) {
+  return m_subscriptions.clearFilters(sessionId);
+}
+
+std::optional<std::vector<CanFilter>>
+TcpServer::getSubscriptions(const SessionId &sessionId) const {
+  return m_subscriptions.getFilters(sessionId);
+}
+
+void TcpServer::setRateLimit(const RateLimit &limit) {
+  m_rateLimit = limit;
+
+  for (const auto &[id, session] : m_sessions) {
+    if (!session->hasOwnRateLimit()) {
+      session->setRateLimit(std::nullopt);
+    }
+  }
+}
+
+bool TcpServer::setClientRateLimit(const SessionId &sessionId,
+                                   std::optional<RateLimit> limit) {
+  auto it = m_sessions.find(sessionId);
+  if (it == m_sessions.end()) {
+    return false;
+  }
+
+  it->second->setRateLimit(limit);
+  return true;
+}
+
+TcpServer::RateLimitStats TcpServer::getRateLimitStats() const {
+  return m_rateLimitStats;
+}
+
+std::optional<TcpServer::RateLimitStats>
+TcpServer::getClientRateLimitStats(const SessionId &sessionId) const {
+  auto it = m_sessions.find(sessionId);
+  if (it == m_sessions.end()) {
+    return std::nullopt;
+  }
+
+  return it->second->getRateLimitStats();
+}
+
+AutoResponder::RuleId
+TcpServer::addAutoResponse(const AutoResponseRule &rule) {
+  return m_autoResponder.addRule(rule);
+}
+
+bool TcpServer::removeAutoResponse(AutoResponder::RuleId ruleId) {
+  return m_autoResponder.removeRule(ruleId);
+}
+
+void TcpServer::clearAutoResponses() { m_autoResponder.clear(); }
+
+std::vector<std::pair<AutoResponder::RuleId, uint64_t>>
+TcpServer::getAutoResponseHits() const {
+  return m_autoResponder.getHitCounts();
+}
+
+std::optional<CanMessage> TcpServer::getLastMessage(uint32_t id,
+                                                    bool extended) const {
+  const CanMessage *message = m_lastValues.find(id, extended);
+  if (message == nullptr) {
+    return std::nullopt;
+  }
+  return *message;
+}
+
+void TcpServer::setSnapshotOnConnect(bool enabled) {
+  m_snapshotOnConnect = enabled;
+}
+
+bool TcpServer::enableTap(const std::string &name, std::size_t slotCount) {
+  auto tap = std::make_unique<ShmRingTap>();
+  if (!tap->open(name, slotCount)) {
+    return false;
+  }
+
+  m_tap = std::move(tap);
+  return true;
+}
+
+void TcpServer::disableTap() { m_tap.reset(); }
+
+void TcpServer::setWireTimestamps(bool enabled) {
+  m_wireTimestamps = enabled;
+}
+
 void TcpServer::setMessageCallback(MessageCallback callback) {
   m_messageCallback = std::move(callback);
 }
@@ -76,15 +263,40 @@ void TcpServer::setDisconnectCallback(DisconnectCallback callback) {
 
 void TcpServer::doAccept() {
   m_acceptor.async_accept([this](std::error_code ec, tcp::socket socket) {
-    if (!ec) {
+    if (!ec && m_freeSessions.empty()) {
+      // Pool exhausted, the socket is closed when it goes out of scope
+      m_rejectedConnections++;
+      spdlog::warn("Connection limit of {} reached, rejecting client",
+                   m_maxConnections);
+    } else if (!ec) {
       std::string id = std::to_string(m_nextId);
-      auto session = std::make_shared<Session>(std::move(socket), *this, id);
-      m_sessions[id] = session;
+
+      auto session = std::move(m_freeSessions.back());
+      m_freeSessions.pop_back();
+      session->open(std::move(socket), id);
+
+      if (m_freeNodes.empty()) {
+        m_sessions.emplace(id, session);
+      } else {
+        auto node = std::move(m_freeNodes.back());
+        m_freeNodes.pop_back();
+        node.key() = id;
+        node.mapped() = session;
+        m_sessions.insert(std::move(node));
+      }
+      m_peakSessions = std::max(m_peakSessions, m_sessions.size());
+
+      m_subscriptions.addSession(id);
       session->start();
 
       if (m_connectCallback) {
         m_connectCallback(id);
       }
+
+      // After the callback, so subscriptions set there already apply
+      if (m_snapshotOnConnect && m_sessions.count(id) != 0) {
+        sendSnapshot(*session);
+      }
       m_nextId++;
     }
 
@@ -100,45 +312,201 @@ void TcpServer::removeSession(const std::string &id) {
     return;
   }
 
-  m_sessions.erase(it);
+  // id may refer to the session's own storage, keep a copy
+  const SessionId removedId = id;
+  releaseSession(it);
 
   if (m_disconnectCallback) {
-    m_disconnectCallback(id);
+    m_disconnectCallback(removedId);
+  }
+}
+
+void TcpServer::releaseSession(SessionMap::iterator it) {
+  m_subscriptions.removeSession(it->first);
+
+  auto node = m_sessions.extract(it);
+  node.mapped()->stop();
+  m_freeSessions.push_back(std::move(node.mapped()));
+  m_freeNodes.push_back(std::move(node));
+}
+
+void TcpServer::handleControlMessage(const SessionId &id,
+                                     const CanMessage &message) {
+  const auto &data = message.getData();
+  if (data.empty()) {
+    spdlog::warn("Empty control message from client {}", id);
+    return;
+  }
+
+  // Filters are (id, mask) pairs, 4 bytes each, big-endian
+  std::vector<CanFilter> filters;
+  for (std::size_t offset = 1; offset + 8 <= data.size(); offset += 8) {
+    CanFilter filter;
+    filter.id = static_cast<uint32_t>(data[offset]) << 24 |
+                static_cast<uint32_t>(data[offset + 1]) << 16 |
+                static_cast<uint32_t>(data[offset + 2]) << 8 |
+                static_cast<uint32_t>(data[offset + 3]);
+    filter.mask = static_cast<uint32_t>(data[offset + 4]) << 24 |
+                  static_cast<uint32_t>(data[offset + 5]) << 16 |
+                  static_cast<uint32_t>(data[offset + 6]) << 8 |
+                  static_cast<uint32_t>(data[offset + 7]);
+    filters.push_back(filter);
+  }
+
+  switch (static_cast<ControlCommand>(data[0])) {
+  case ControlCommand::Subscribe:
+    // An empty filter set would silently cut the client off
+    if (filters.empty()) {
+      spdlog::warn("Ignoring subscribe without filters from client {}", id);
+      break;
+    }
+    m_subscriptions.addFilters(id, filters);
+    break;
+  case ControlCommand::Unsubscribe:
+    m_subscriptions.removeFilters(id, filters);
+    break;
+  case ControlCommand::SubscribeAll:
+    m_subscriptions.clearFilters(id);
+    break;
+  default:
+    spdlog::warn("Unknown control command 0x{:02X} from client {}", data[0],
+                 id);
   }
 }
 
-TcpServer::Session::Session(tcp::socket socket, TcpServer &server,
-                            std::string id)
-    : m_socket(std::move(socket)), m_server(server), m_id(std::move(id)),
-      m_bytesNeeded(4) { // First need 4 bytes for length header
+void TcpServer::sendSnapshot(Session &session) {
+  const SessionId id = session.getId();
+
+  m_lastValues.snapshot(m_snapshotMessages);
+  m_snapshotMessages.erase(
+      std::remove_if(m_snapshotMessages.begin(), m_snapshotMessages.end(),
+                     [this, &id](const CanMessage *message) {
+                       return !m_subscriptions.matches(id, message->getID());
+                     }),
+      m_snapshotMessages.end());
+
+  if (!m_snapshotMessages.empty()) {
+    session.send(m_snapshotMessages);
+  }
+}
+
+bool TcpServer::applyAutoResponse(Session &sender,
+                                  const CanMessage &message) {
+  const AutoResponseRule *rule = m_autoResponder.match(message);
+  if (rule == nullptr) {
+    return false;
+  }
+
+  m_autoResponder.buildReply(*rule, message, m_autoReply);
+
+  if (rule->target == AutoResponseRule::Target::Broadcast) {
+    broadcastMessage(m_autoReply);
+  } else {
+    sender.send(m_autoReply);
+  }
+
+  return true;
+}
+
+TcpServer::Session::Session(TcpServer &server)
+    : m_socket(server.m_acceptor.get_executor()), m_server(server),
+      m_bytesNeeded(4), // First need 4 bytes for length header
+      m_kernelTimestamps(false), m_receiveTimestamp(0), m_ownRateLimit(false),
+      m_resumeTimer(server.m_acceptor.get_executor()), m_generation(0) {
   m_readBuffer.resize(1024);
+  m_messageBuffer.reserve(1024);
+  m_writeBuffer.reserve(1024);
 }
 
-void TcpServer::Session::start() { doRead(); }
+void TcpServer::Session::open(tcp::socket socket, const SessionId &id) {
+  m_socket = std::move(socket);
+  m_id = id;
+  m_bytesNeeded = 4;
+  m_messageBuffer.clear();
+  m_receiveTimestamp = 0;
+  m_rateLimitStats = RateLimitStats{};
+  setRateLimit(std::nullopt);
+}
+
+void TcpServer::Session::start() {
+  m_kernelTimestamps = enableKernelTimestamps();
+  doRead();
+}
 
 void TcpServer::Session::stop() {
+  m_generation++;
+  m_resumeTimer.cancel();
+
   std::error_code ec;
   m_socket.close(ec);
 }
 
 bool TcpServer::Session::send(const CanMessage &message) {
-  try {
-    auto data = message.serialize();
+  m_writeBuffer.clear();
+  appendFrame(message);
+  return flush();
+}
 
-    // Prepend with a 4-byte length header
-    std::vector<uint8_t> buffer;
-    buffer.reserve(data.size() + 4);
+bool TcpServer::Session::send(const std::vector<const CanMessage *> &messages) {
+  // All frames go out in a single write
+  m_writeBuffer.clear();
+  for (const auto *message : messages) {
+    appendFrame(*message);
+  }
+  return flush();
+}
 
-    auto size = static_cast<uint32_t>(data.size());
-    buffer.push_back(static_cast<uint8_t>((size >> 24) & 0xFF));
-    buffer.push_back(static_cast<uint8_t>((size >> 16) & 0xFF));
-    buffer.push_back(static_cast<uint8_t>((size >> 8) & 0xFF));
-    buffer.push_back(static_cast<uint8_t>(size & 0xFF));
+bool TcpServer::Session::send(const CanMessage *messages, std::size_t count) {
+  m_writeBuffer.clear();
+  for (std::size_t i = 0; i < count; ++i) {
+    appendFrame(messages[i]);
+  }
+  return flush();
+}
 
-    buffer.insert(buffer.end(), data.begin(), data.end());
+bool TcpServer::Session::addToBatch(const CanMessage &message) {
+  m_batch.push_back(&message);
+  return m_batch.size() == 1;
+}
 
+bool TcpServer::Session::flushBatch() {
+  bool success = send(m_batch);
+  m_batch.clear();
+  return success;
+}
+
+void TcpServer::Session::appendFrame(const CanMessage &message) {
+  // Reserve the 4-byte length header, fill it in once the size is known
+  const std::size_t headerOffset = m_writeBuffer.size();
+  m_writeBuffer.resize(headerOffset + 4);
+
+  message.serializeTo(m_writeBuffer, m_server.m_wireTimestamps);
+
+  // Frames without a timestamp of their own carry the send time
+  if (m_server.m_wireTimestamps && message.getTimestamp() == 0) {
+    uint64_t now = CanMessage::currentTimestamp();
+    std::size_t timestampOffset = headerOffset + 4 + 6;
+    for (int i = 0; i < 8; ++i) {
+      m_writeBuffer[timestampOffset + i] =
+          static_cast<uint8_t>((now >> (56 - 8 * i)) & 0xFF);
+    }
+  }
+
+  if (m_server.m_tap) {
+    m_server.m_tap->publish(m_id, message, ShmRing::Direction::Outbound);
+  }
+
+  auto size = static_cast<uint32_t>(m_writeBuffer.size() - headerOffset - 4);
+  m_writeBuffer[headerOffset] = static_cast<uint8_t>((size >> 24) & 0xFF);
+  m_writeBuffer[headerOffset + 1] = static_cast<uint8_t>((size >> 16) & 0xFF);
+  m_writeBuffer[headerOffset + 2] = static_cast<uint8_t>((size >> 8) & 0xFF);
+  m_writeBuffer[headerOffset + 3] = static_cast<uint8_t>(size & 0xFF);
+}
+
+bool TcpServer::Session::flush() {
+  try {
     // Synchronous write for simplicity
-    asio::write(m_socket, asio::buffer(buffer));
+    asio::write(m_socket, asio::buffer(m_writeBuffer));
     return true;
   } catch (const asio::system_error &exception) {
     spdlog::error("Error sending to client {}: {}", m_id, exception.what());
@@ -148,12 +516,160 @@ bool TcpServer::Session::send(const CanMessage &message) {
 
 std::string TcpServer::Session::getId() const { return m_id; }
 
+void TcpServer::Session::setRateLimit(std::optional<RateLimit> limit) {
+  m_ownRateLimit = limit.has_value();
+  m_rateLimit = limit.value_or(m_server.m_rateLimit);
+  configureBuckets(m_rateLimit);
+}
+
+bool TcpServer::Session::hasOwnRateLimit() const { return m_ownRateLimit; }
+
+const TcpServer::RateLimitStats &
+TcpServer::Session::getRateLimitStats() const {
+  return m_rateLimitStats;
+}
+
+void TcpServer::Session::configureBuckets(const RateLimit &limit) {
+  // Allow bursts of one second worth of traffic
+  const uint64_t now = CanMessage::currentTimestamp();
+  m_frameBucket.configure(limit.framesPerSecond, limit.framesPerSecond, now);
+  m_byteBucket.configure(limit.bytesPerSecond, limit.bytesPerSecond, now);
+}
+
+TcpServer::Session::Admission
+TcpServer::Session::admitFrame(std::size_t frameBytes) {
+  if (!m_frameBucket.isLimited() && !m_byteBucket.isLimited()) {
+    return Admission::Accept;
+  }
+
+  const uint64_t now = CanMessage::currentTimestamp();
+  const auto bytes = static_cast<double>(frameBytes);
+  m_frameBucket.refill(now);
+  m_byteBucket.refill(now);
+
+  if (m_frameBucket.hasTokens(1.0) && m_byteBucket.hasTokens(bytes)) {
+    m_frameBucket.consume(1.0);
+    m_byteBucket.consume(bytes);
+    return Admission::Accept;
+  }
+
+  if (m_rateLimit.mode == ThrottleMode::Pause) {
+    m_rateLimitStats.delayedFrames++;
+    m_server.m_rateLimitStats.delayedFrames++;
+    return Admission::Pause;
+  }
+
+  m_rateLimitStats.droppedFrames++;
+  m_rateLimitStats.droppedBytes += frameBytes;
+  m_server.m_rateLimitStats.droppedFrames++;
+  m_server.m_rateLimitStats.droppedBytes += frameBytes;
+  return Admission::Drop;
+}
+
+void TcpServer::Session::pauseReading() {
+  m_rateLimitStats.pauses++;
+  m_server.m_rateLimitStats.pauses++;
+
+  // No read is pending while paused, so the client is held back by TCP
+  // flow control until the buckets have refilled
+  const auto bytes = static_cast<double>(m_bytesNeeded);
+  const uint64_t delay = std::max<uint64_t>(
+      {m_frameBucket.delayFor(1.0), m_byteBucket.delayFor(bytes), 1000000});
+
+  auto self = shared_from_this();
+  const uint64_t generation = m_generation;
+
+  m_resumeTimer.expires_after(std::chrono::nanoseconds(delay));
+  m_resumeTimer.async_wait([self, generation](std::error_code ec) {
+    if (!ec && self->m_generation == generation) {
+      self->processBuffer();
+    }
+  });
+}
+
+bool TcpServer::Session::enableKernelTimestamps() {
+#ifdef __linux__
+  int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  return ::setsockopt(m_socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPING,
+                      &flags, sizeof(flags)) == 0;
+#else
+  return false;
+#endif
+}
+
 void TcpServer::Session::doRead() {
   auto self = shared_from_this();
-  m_socket.async_read_some(asio::buffer(m_readBuffer),
-                           std::bind(&Session::handleReadComplete, self,
-                                     std::placeholders::_1,
-                                     std::placeholders::_2));
+  const uint64_t generation = m_generation;
+
+  // Kernel timestamps arrive as ancillary data, which only recvmsg returns
+  if (m_kernelTimestamps) {
+    m_socket.async_wait(tcp::socket::wait_read,
+                        [self, generation](std::error_code ec) {
+                          if (self->m_generation == generation) {
+                            self->handleReadable(ec);
+                          }
+                        });
+    return;
+  }
+
+  m_socket.async_read_some(
+      asio::buffer(m_readBuffer),
+      [self, generation](std::error_code ec, std::size_t bytesRead) {
+        if (self->m_generation == generation) {
+          self->handleReadComplete(ec, bytesRead);
+        }
+      });
+}
+
+void TcpServer::Session::handleReadable(std::error_code ec) {
+#ifdef __linux__
+  if (ec) {
+    handleReadComplete(ec, 0);
+    return;
+  }
+
+  iovec iov{m_readBuffer.data(), m_readBuffer.size()};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(scm_timestamping))];
+
+  msghdr header{};
+  header.msg_iov = &iov;
+  header.msg_iovlen = 1;
+  header.msg_control = control;
+  header.msg_controllen = sizeof(control);
+
+  ssize_t bytesRead =
+      ::recvmsg(m_socket.native_handle(), &header, MSG_DONTWAIT);
+  if (bytesRead < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      doRead();
+      return;
+    }
+    handleReadComplete(
+        std::error_code(errno, asio::error::get_system_category()), 0);
+    return;
+  }
+
+  if (bytesRead == 0) {
+    handleReadComplete(asio::error::eof, 0);
+    return;
+  }
+
+  for (cmsghdr *message = CMSG_FIRSTHDR(&header); message != nullptr;
+       message = CMSG_NXTHDR(&header, message)) {
+    if (message->cmsg_level == SOL_SOCKET &&
+        message->cmsg_type == SCM_TIMESTAMPING) {
+      scm_timestamping stamps{};
+      std::memcpy(&stamps, CMSG_DATA(message), sizeof(stamps));
+      if (stamps.ts[0].tv_sec != 0 || stamps.ts[0].tv_nsec != 0) {
+        m_receiveTimestamp = toMonotonic(stamps.ts[0]);
+      }
+    }
+  }
+
+  handleReadComplete(ec, static_cast<std::size_t>(bytesRead));
+#else
+  handleReadComplete(ec, 0);
+#endif
 }
 
 void TcpServer::Session::handleReadComplete(std::error_code ec,
@@ -166,10 +682,19 @@ void TcpServer::Session::handleReadComplete(std::error_code ec,
     return;
   }
 
+  // Fall back to the completion time if the kernel gave no timestamp
+  if (m_receiveTimestamp == 0) {
+    m_receiveTimestamp = CanMessage::currentTimestamp();
+  }
+
   // Append new data to buffer
   m_messageBuffer.insert(m_messageBuffer.end(), m_readBuffer.begin(),
                          m_readBuffer.begin() + bytesRead);
 
+  processBuffer();
+}
+
+void TcpServer::Session::processBuffer() {
   while (m_messageBuffer.size() >= m_bytesNeeded) {
     if (m_bytesNeeded == 4) {
       // Parse length header
@@ -185,7 +710,17 @@ void TcpServer::Session::handleReadComplete(std::error_code ec,
 
       m_bytesNeeded = 4 + msgLength;
     } else {
-      processMessage();
+      // Rate limits are enforced before the frame is decoded
+      switch (admitFrame(m_bytesNeeded)) {
+      case Admission::Accept:
+        processMessage();
+        break;
+      case Admission::Drop:
+        break;
+      case Admission::Pause:
+        pauseReading();
+        return;
+      }
 
       m_messageBuffer.erase(m_messageBuffer.begin(),
                             m_messageBuffer.begin() + m_bytesNeeded);
@@ -193,6 +728,7 @@ void TcpServer::Session::handleReadComplete(std::error_code ec,
     }
   }
 
+  m_receiveTimestamp = 0;
   doRead();
 }
 
@@ -202,6 +738,23 @@ void TcpServer::Session::processMessage() {
                                m_messageBuffer.end());
 
   auto canMessage = CanMessage::deserialize(canData);
+  canMessage.setTimestamp(m_receiveTimestamp);
+
+  if (canMessage.isControl()) {
+    m_server.handleControlMessage(m_id, canMessage);
+    return;
+  }
+
+  if (m_server.m_tap) {
+    m_server.m_tap->publish(m_id, canMessage, ShmRing::Direction::Inbound);
+  }
+
+  m_server.m_lastValues.update(canMessage);
+
+  // Frames answered by a rule never reach the script
+  if (m_server.applyAutoResponse(*this, canMessage)) {
+    return;
+  }
 
   if (m_server.m_messageCallback) {
     m_server.m_messageCallback(m_id, canMessage);
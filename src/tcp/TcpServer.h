@@ -1,7 +1,12 @@
 #pragma once
 
 #include <can/CanMessage.h>
+#include <can/LastValueCache.h>
+#include <shm/ShmRingTap.h>
+#include <tcp/AutoResponder.h>
 #include <tcp/ITcpServer.h>
+#include <tcp/SubscriptionIndex.h>
+#include <tcp/TokenBucket.h>
 
 #include <asio.hpp>
 
@@ -12,7 +17,12 @@
 
 class TcpServer : public ITcpServer {
 public:
-  explicit TcpServer(asio::io_context &ioContext, uint16_t port);
+  static constexpr std::size_t DefaultMaxConnections = 128;
+  // Sessions are preallocated, so the pool size is capped
+  static constexpr std::size_t MaxConnectionsLimit = 16384;
+
+  explicit TcpServer(asio::io_context &ioContext, uint16_t port,
+                     std::size_t maxConnections = DefaultMaxConnections);
   ~TcpServer() override;
 
   void start() override;
@@ -21,24 +31,90 @@ public:
   bool sendMessage(const SessionId &sessionId,
                    const CanMessage &message) override;
   void broadcastMessage(const CanMessage &message) override;
+  bool sendMessages(const SessionId &sessionId, const CanMessage *messages,
+                    std::size_t count) override;
+  void broadcastMessages(const CanMessage *messages,
+                         std::size_t count) override;
   std::vector<SessionId> getConnectedClients() const override;
+  SessionPoolStats getSessionPoolStats() const override;
+
+  bool setSubscriptions(const SessionId &sessionId,
+                        const std::vector<CanFilter> &filters) override;
+  bool clearSubscriptions(const SessionId &sessionId) override;
+  std::optional<std::vector<CanFilter>>
+  getSubscriptions(const SessionId &sessionId) const override;
+
+  void setRateLimit(const RateLimit &limit) override;
+  bool setClientRateLimit(const SessionId &sessionId,
+                          std::optional<RateLimit> limit) override;
+  RateLimitStats getRateLimitStats() const override;
+  std::optional<RateLimitStats>
+  getClientRateLimitStats(const SessionId &sessionId) const override;
+
+  AutoResponder::RuleId
+  addAutoResponse(const AutoResponseRule &rule) override;
+  bool removeAutoResponse(AutoResponder::RuleId ruleId) override;
+  void clearAutoResponses() override;
+  std::vector<std::pair<AutoResponder::RuleId, uint64_t>>
+  getAutoResponseHits() const override;
+
+  std::optional<CanMessage> getLastMessage(uint32_t id,
+                                           bool extended) const override;
+  void setSnapshotOnConnect(bool enabled) override;
+
+  bool enableTap(const std::string &name, std::size_t slotCount) override;
+  void disableTap() override;
+
+  void setWireTimestamps(bool enabled) override;
 
   void setMessageCallback(MessageCallback callback) override;
   void setConnectCallback(ConnectCallback callback) override;
   void setDisconnectCallback(DisconnectCallback callback) override;
 
 private:
+  // First data byte of a control frame
+  enum class ControlCommand : uint8_t {
+    Subscribe = 0x01,   // followed by (id, mask) pairs
+    Unsubscribe = 0x02, // followed by (id, mask) pairs
+    SubscribeAll = 0x03 // drop all filters, receive everything
+  };
+
+  // Sessions are preallocated and recycled; open() binds one to a new
+  // connection and stop() releases it again
   class Session : public std::enable_shared_from_this<Session> {
   public:
-    Session(tcp::socket socket, TcpServer &server, SessionId id);
+    explicit Session(TcpServer &server);
+    void open(tcp::socket socket, const SessionId &id);
     void start();
     void stop();
     bool send(const CanMessage &message);
+    bool send(const std::vector<const CanMessage *> &messages);
+    bool send(const CanMessage *messages, std::size_t count);
+
+    // Frames collected by a batched broadcast; addToBatch returns true for
+    // the first frame, flushBatch sends them in one write
+    bool addToBatch(const CanMessage &message);
+    bool flushBatch();
     SessionId getId() const;
 
+    // Apply a rate limit; std::nullopt falls back to the server-wide one
+    void setRateLimit(std::optional<RateLimit> limit);
+    bool hasOwnRateLimit() const;
+    const RateLimitStats &getRateLimitStats() const;
+
   private:
+    enum class Admission { Accept, Drop, Pause };
+
+    void configureBuckets(const RateLimit &limit);
+    Admission admitFrame(std::size_t frameBytes);
+    void pauseReading();
+    void processBuffer();
+    void appendFrame(const CanMessage &message);
+    bool flush();
+    bool enableKernelTimestamps();
     void doRead();
     void processMessage();
+    void handleReadable(std::error_code ec);
     void handleReadComplete(std::error_code ec, std::size_t bytesRead);
 
     tcp::socket m_socket;
@@ -47,15 +123,56 @@ private:
     std::vector<uint8_t> m_readBuffer;
     std::size_t m_bytesNeeded;
     std::vector<uint8_t> m_messageBuffer;
+    std::vector<uint8_t> m_writeBuffer;
+    std::vector<const CanMessage *> m_batch;
+    bool m_kernelTimestamps;
+    uint64_t m_receiveTimestamp;
+
+    // Inbound rate limiting
+    bool m_ownRateLimit;
+    RateLimit m_rateLimit;
+    TokenBucket m_frameBucket;
+    TokenBucket m_byteBucket;
+    RateLimitStats m_rateLimitStats;
+    asio::steady_timer m_resumeTimer;
+
+    // Bumped on stop() so completions of a previous connection are ignored
+    uint64_t m_generation;
   };
 
+  using SessionMap = std::unordered_map<SessionId, std::shared_ptr<Session>>;
+
   void doAccept();
   void removeSession(const SessionId &id);
+  void releaseSession(SessionMap::iterator it);
+  void handleControlMessage(const SessionId &id, const CanMessage &message);
+  void sendSnapshot(Session &session);
+  bool applyAutoResponse(Session &sender, const CanMessage &message);
 
   tcp::acceptor m_acceptor;
-  std::unordered_map<SessionId, std::shared_ptr<Session>> m_sessions;
+  SessionMap m_sessions;
+
+  // Session pool; map nodes are recycled too so accepting does not allocate
+  std::size_t m_maxConnections;
+  std::vector<std::shared_ptr<Session>> m_freeSessions;
+  std::vector<SessionMap::node_type> m_freeNodes;
+  std::size_t m_peakSessions;
+  uint64_t m_rejectedConnections;
+
+  SubscriptionIndex m_subscriptions;
+  std::vector<const SessionId *> m_broadcastTargets;
+  std::vector<Session *> m_batchSessions;
+  RateLimit m_rateLimit;
+  RateLimitStats m_rateLimitStats;
+  AutoResponder m_autoResponder;
+  CanMessage m_autoReply;
+  LastValueCache m_lastValues;
+  std::unique_ptr<ShmRingTap> m_tap;
+  std::vector<const CanMessage *> m_snapshotMessages;
+  bool m_snapshotOnConnect;
   std::atomic<bool> m_running;
   uint64_t m_nextId;
+  bool m_wireTimestamps;
 
   MessageCallback m_messageCallback;
   ConnectCallback m_connectCallback;
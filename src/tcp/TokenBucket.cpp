@@ -0,0 +1,43 @@
+#include "TokenBucket.h"
+
+#include <algorithm>
+#include <cmath>
+
+void TokenBucket::configure(double ratePerSecond, double burst,
+                            uint64_t now) {
+  m_rate = std::max(ratePerSecond, 0.0);
+  m_burst = std::max(burst, 0.0);
+  m_tokens = m_burst;
+  m_lastRefill = now;
+}
+
+bool TokenBucket::isLimited() const { return m_rate > 0.0; }
+
+void TokenBucket::refill(uint64_t now) {
+  if (now <= m_lastRefill) {
+    return;
+  }
+
+  double elapsed = static_cast<double>(now - m_lastRefill) / 1e9;
+  m_tokens = std::min(m_burst, m_tokens + elapsed * m_rate);
+  m_lastRefill = now;
+}
+
+bool TokenBucket::hasTokens(double tokens) const {
+  return !isLimited() || m_tokens >= std::min(tokens, m_burst);
+}
+
+void TokenBucket::consume(double tokens) {
+  if (isLimited()) {
+    m_tokens -= tokens;
+  }
+}
+
+uint64_t TokenBucket::delayFor(double tokens) const {
+  if (hasTokens(tokens)) {
+    return 0;
+  }
+
+  double missing = std::min(tokens, m_burst) - m_tokens;
+  return static_cast<uint64_t>(std::ceil(missing / m_rate * 1e9));
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+// Token bucket rate limiter working on nanosecond timestamps.
+//
+// A request larger than the burst size is still admitted once the bucket is
+// full; the bucket then goes into debt so the long-term rate holds.
+class TokenBucket {
+public:
+  // A rate of 0 disables the limit
+  void configure(double ratePerSecond, double burst, uint64_t now);
+  bool isLimited() const;
+
+  void refill(uint64_t now);
+  bool hasTokens(double tokens) const;
+  void consume(double tokens);
+
+  // Nanoseconds until hasTokens(tokens) becomes true
+  uint64_t delayFor(double tokens) const;
+
+private:
+  double m_rate = 0.0;
+  double m_burst = 0.0;
+  double m_tokens = 0.0;
+  uint64_t m_lastRefill = 0;
+};